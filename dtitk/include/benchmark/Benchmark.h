@@ -0,0 +1,263 @@
+/*============================================================================
+
+  Program:     DTI ToolKit (DTI-TK)
+  Module:      $RCSfile: Benchmark.h,v $
+  Language:    C++
+  Date:        $Date: 2026/10/18 18:20:05 $
+  Version:     $Revision: 1.1 $
+
+  Copyright (c) Gary Hui Zhang (garyhuizhang@gmail.com).
+  All rights reserverd.
+
+  DTI-TK is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  DTI-TK is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with DTI-TK.  If not, see <http://www.gnu.org/licenses/>.
+============================================================================*/
+
+
+// class BenchmarkResult, class BenchmarkReport and function measure
+//
+// declaration and implementation
+//
+// the bookkeeping shared by the benchmarks.  a kernel is anything with
+//
+//   void prepare ();   // untimed, called before every repeat
+//   double run ();     // timed, returns a checksum of its output
+//
+// measure runs it a number of times and keeps the best, median and mean
+// wall times and the checksum of the last run.  the checksum catches the
+// kernels that got faster by computing something else.
+//
+// a report is written as JSON for the dashboards, or as CSV, which is
+// also what compareWith reads back as the baseline of a build.
+
+#ifndef _benchmark_Benchmark_H
+#define _benchmark_Benchmark_H
+
+#include "../io/Profiler.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+namespace benchmark {
+	
+	using namespace std;
+	
+	struct BenchmarkResult {
+		string kernel;
+		string variant;
+		int size[3];
+		int threads;
+		int repeats;
+		
+		// wall times in seconds
+		double best;
+		double median;
+		double mean;
+		
+		// voxels (or points) processed per run
+		unsigned long long voxels;
+		
+		double checksum;
+		
+		BenchmarkResult () : threads(1), repeats(0), best(0.0), median(0.0), mean(0.0), voxels(0), checksum(0.0) {
+			size[0] = size[1] = size[2] = 0;
+		}
+		
+		// identifies the result across reports
+		string getKey () const {
+			ostringstream oss;
+			oss << kernel << '/' << variant << '/';
+			oss << size[0] << 'x' << size[1] << 'x' << size[2] << '/' << threads;
+			return oss.str();
+		}
+		
+		// voxels per second
+		double getThroughput () const {
+			return best > 0.0 ? voxels / best : 0.0;
+		}
+	};
+	
+	template <class Kernel>
+	BenchmarkResult measure (Kernel& kernel, const int repeats) {
+		BenchmarkResult result;
+		result.repeats = repeats;
+		vector<double> times;
+		for (int r = 0; r < repeats; ++r) {
+			kernel.prepare();
+			const double t1 = io::Profiler::getWallTime();
+			result.checksum = kernel.run();
+			times.push_back(io::Profiler::getWallTime() - t1);
+		}
+		if (times.size() == 0) {
+			return result;
+		}
+		sort(times.begin(), times.end());
+		result.best = times[0];
+		result.median = times[times.size() / 2];
+		double sum = 0.0;
+		for (size_t r = 0; r < times.size(); ++r) {
+			sum += times[r];
+		}
+		result.mean = sum / times.size();
+		return result;
+	}
+	
+	class BenchmarkReport {
+		protected:
+		vector<BenchmarkResult> results;
+		
+		public:
+		void add (const BenchmarkResult& in) {
+			results.push_back(in);
+		}
+		
+		const vector<BenchmarkResult>& getResults () const {
+			return results;
+		}
+		
+		void writeJSON (ostream& out) const {
+			out << setprecision(10);
+			out << "[";
+			for (size_t r = 0; r < results.size(); ++r) {
+				const BenchmarkResult& res = results[r];
+				out << (r == 0 ? "" : ",") << endl;
+				out << "  {\"kernel\": \"" << res.kernel << "\"";
+				out << ", \"variant\": \"" << res.variant << "\"";
+				out << ", \"size\": [" << res.size[0] << ", " << res.size[1] << ", " << res.size[2] << "]";
+				out << ", \"threads\": " << res.threads;
+				out << ", \"repeats\": " << res.repeats;
+				out << ", \"best\": " << res.best;
+				out << ", \"median\": " << res.median;
+				out << ", \"mean\": " << res.mean;
+				out << ", \"voxels\": " << res.voxels;
+				out << ", \"throughput\": " << res.getThroughput();
+				out << ", \"checksum\": " << res.checksum << "}";
+			}
+			out << endl << "]" << endl;
+		}
+		
+		void writeCSV (ostream& out) const {
+			out << "kernel,variant,xsize,ysize,zsize,threads,repeats,best,median,mean,voxels,throughput,checksum" << endl;
+			out << setprecision(17);
+			for (size_t r = 0; r < results.size(); ++r) {
+				const BenchmarkResult& res = results[r];
+				out << res.kernel << ',' << res.variant << ',';
+				out << res.size[0] << ',' << res.size[1] << ',' << res.size[2] << ',';
+				out << res.threads << ',' << res.repeats << ',';
+				out << res.best << ',' << res.median << ',' << res.mean << ',';
+				out << res.voxels << ',' << res.getThroughput() << ',' << res.checksum << endl;
+			}
+		}
+		
+		bool writeJSON (const char *filename) const {
+			ofstream out(filename);
+			if (!out) {
+				cerr << "Fail to write the benchmark report to " << filename << endl;
+				return false;
+			}
+			writeJSON(out);
+			return true;
+		}
+		
+		bool writeCSV (const char *filename) const {
+			ofstream out(filename);
+			if (!out) {
+				cerr << "Fail to write the benchmark report to " << filename << endl;
+				return false;
+			}
+			writeCSV(out);
+			return true;
+		}
+		
+		// read a report written by writeCSV
+		bool readCSV (const char *filename) {
+			ifstream in(filename);
+			if (!in) {
+				cerr << "Fail to read the benchmark report " << filename << endl;
+				return false;
+			}
+			results.clear();
+			string line;
+			// skip the header
+			getline(in, line);
+			while (getline(in, line)) {
+				if (line.size() == 0) {
+					continue;
+				}
+				vector<string> fields;
+				istringstream iss(line);
+				string field;
+				while (getline(iss, field, ',')) {
+					fields.push_back(field);
+				}
+				if (fields.size() != 13) {
+					cerr << "Invalid line in " << filename << ": " << line << endl;
+					return false;
+				}
+				BenchmarkResult res;
+				res.kernel = fields[0];
+				res.variant = fields[1];
+				for (int m = 0; m < 3; ++m) {
+					res.size[m] = atoi(fields[2 + m].c_str());
+				}
+				res.threads = atoi(fields[5].c_str());
+				res.repeats = atoi(fields[6].c_str());
+				res.best = atof(fields[7].c_str());
+				res.median = atof(fields[8].c_str());
+				res.mean = atof(fields[9].c_str());
+				res.voxels = strtoull(fields[10].c_str(), NULL, 10);
+				res.checksum = atof(fields[12].c_str());
+				results.push_back(res);
+			}
+			return true;
+		}
+		
+		// report the results slower than the baseline by more than the
+		// relative timeTolerance, or whose checksum differs by more than
+		// the relative checksumTolerance; returns their number
+		int compareWith (const BenchmarkReport& baseline, const double timeTolerance,
+			const double checksumTolerance, ostream& out) const {
+			int regressions = 0;
+			for (size_t r = 0; r < results.size(); ++r) {
+				const BenchmarkResult& res = results[r];
+				const string key = res.getKey();
+				for (size_t b = 0; b < baseline.results.size(); ++b) {
+					const BenchmarkResult& base = baseline.results[b];
+					if (base.getKey() != key) {
+						continue;
+					}
+					if (res.best > base.best * (1.0 + timeTolerance)) {
+						out << "slower: " << key << ' ' << base.best << "s -> " << res.best << 's' << endl;
+						++regressions;
+					}
+					const double scale = max(1.0, fabs(base.checksum));
+					if (fabs(res.checksum - base.checksum) > checksumTolerance * scale) {
+						out << "checksum: " << key << ' ' << base.checksum << " -> " << res.checksum << endl;
+						++regressions;
+					}
+					break;
+				}
+			}
+			return regressions;
+		}
+	};
+
+}
+
+#endif
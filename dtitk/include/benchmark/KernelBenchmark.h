@@ -0,0 +1,563 @@
+/*============================================================================
+
+  Program:     DTI ToolKit (DTI-TK)
+  Module:      $RCSfile: KernelBenchmark.h,v $
+  Language:    C++
+  Date:        $Date: 2026/10/18 18:41:37 $
+  Version:     $Revision: 1.1 $
+
+  Copyright (c) Gary Hui Zhang (garyhuizhang@gmail.com).
+  All rights reserverd.
+
+  DTI-TK is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  DTI-TK is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with DTI-TK.  If not, see <http://www.gnu.org/licenses/>.
+============================================================================*/
+
+
+// class KernelBenchmark
+//
+// declaration and implementation
+//
+// times the core kernels on synthetic tensor volumes, at every grid
+// size and thread count requested:
+//
+//   interpolation       trilinear and cubic B-spline, random points
+//   gaussianSmoothing   sigma of one voxel
+//   similarityGradient  AffineSymTensor3DVolume, for EDS, GDS and DDS
+//   transformBackward   a random affine, a random piecewise affine and a
+//                       random deformation, trilinear
+//   squaring            DeformationField3D::squaring
+//   inverse             DeformationField3D::computeInverse
+//   niftiWrite          SymTensor3DVolume::writeVolAs
+//   niftiRead           the SymTensor3DVolume constructor
+//
+// the template is a synthetic Line and the subject a synthetic Sheet,
+// both built with a fixed seed.  the affine is drawn around the identity,
+// the piecewise affine is a 4x4x4 grid of such affines and the
+// deformation a sum of sinusoids of up to 1.5 voxels with random
+// amplitudes and phases, all from the seed set with setSeed, so the
+// checksums are reproducible from build to build for a given seed.
+//
+// the thread counts are applied with omp_set_num_threads; without
+// OpenMP only the single threaded runs are made.
+
+#ifndef _benchmark_KernelBenchmark_H
+#define _benchmark_KernelBenchmark_H
+
+#include "Benchmark.h"
+#include "../synthetic/Line.h"
+#include "../synthetic/Sheet.h"
+#include "../geometry/Affine3D.h"
+#include "../geometry/PiecewiseAffine3D.h"
+#include "../volume/AffineSymTensor3DVolume.h"
+#include "../volume/PiecewiseAffineSymTensor3DVolume.h"
+#include "../volume/DeformationSymTensor3DVolume.h"
+#include "../volume/DeformationField3D.h"
+#include "../volume/FloatVolume.h"
+#include <cstdio>
+#include <unistd.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace benchmark {
+	
+	using namespace geometry;
+	using namespace volume;
+	using namespace synthetic;
+	
+	// the sum of all the components, the checksum of the kernels
+	template <class Object>
+	double computeChecksum (const Volume<Object>& vol) {
+		typedef FloatVolumeComponents<Object> Components;
+		int sz[3];
+		vol.getSize(sz);
+		double sum = 0.0;
+		for (int i = 0; i < sz[0]; ++i) {
+			for (int j = 0; j < sz[1]; ++j) {
+				for (int k = 0; k < sz[2]; ++k) {
+					const double *c = Components::get(vol.voxel[i][j][k]);
+					for (int m = 0; m < Components::N; ++m) {
+						sum += c[m];
+					}
+				}
+			}
+		}
+		return sum;
+	}
+	
+	// a copy with the same voxel space
+	template <class VolumeType>
+	VolumeType *copyOf (const VolumeType& in) {
+		int sz[3];
+		double vsz[3];
+		double org[3];
+		in.getSize(sz);
+		in.getVSize(vsz);
+		in.getOrigin(org);
+		VolumeType *out = new VolumeType(sz);
+		out->setVSize(vsz);
+		out->setOrigin(org);
+		*out = in;
+		return out;
+	}
+	
+	class InterpolationKernel {
+		protected:
+		const SymTensor3DVolume& vol;
+		const int intp;
+		vector<Vector3D> points;
+		
+		public:
+		InterpolationKernel (const SymTensor3DVolume& vol, const int n, const int intp) : vol(vol), intp(intp) {
+			int sz[3];
+			vol.getSize(sz);
+			// a fixed linear congruential sequence
+			unsigned long long state = 12345;
+			points.resize(n);
+			for (int p = 0; p < n; ++p) {
+				for (int m = 0; m < 3; ++m) {
+					state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+					points[p][m] = (state >> 11) * (1.0 / 9007199254740992.0) * (sz[m] - 1);
+				}
+				vol.toAbs(points[p]);
+			}
+		}
+		
+		void prepare () {}
+		
+		// the points are split over the threads; the coefficients of
+		// the B-spline are built beforehand, so getVoxelAt only reads
+		double run () {
+			const int n = points.size();
+			double sum = 0.0;
+#ifdef _OPENMP
+			#pragma omp parallel for reduction(+:sum)
+#endif
+			for (int p = 0; p < n; ++p) {
+				SymTensor3D out;
+				vol.getVoxelAt(points[p], out, intp);
+				for (int m = 0; m < 6; ++m) {
+					sum += out[m];
+				}
+			}
+			return sum;
+		}
+	};
+	
+	class SmoothingKernel {
+		protected:
+		const SymTensor3DVolume& src;
+		SymTensor3DVolume *work;
+		double sigma[3];
+		
+		public:
+		SmoothingKernel (const SymTensor3DVolume& src) : src(src) {
+			work = copyOf(src);
+			// in voxels
+			sigma[0] = sigma[1] = sigma[2] = 1.0;
+		}
+		
+		~SmoothingKernel () {
+			delete work;
+		}
+		
+		void prepare () {
+			*work = src;
+		}
+		
+		double run () {
+			work->gaussianSmoothing(sigma);
+			return computeChecksum(*work);
+		}
+	};
+	
+	class SimilarityGradientKernel {
+		protected:
+		AffineSymTensor3DVolume& tmpl;
+		const SymTensor3DVolume& subj;
+		const SymTensor3D::SimilarityMeasure sm;
+		
+		public:
+		SimilarityGradientKernel (AffineSymTensor3DVolume& tmpl, const SymTensor3DVolume& subj,
+			const SymTensor3D::SimilarityMeasure sm) : tmpl(tmpl), subj(subj), sm(sm) {}
+		
+		void prepare () {
+			SymTensor3D::setSMOption(sm);
+		}
+		
+		double run () {
+			double xi[12];
+			double sum = tmpl.computeSimilarityGradientRegion(subj, NULL, xi, 12, 0);
+			for (int m = 0; m < 12; ++m) {
+				sum += xi[m];
+			}
+			return sum;
+		}
+	};
+	
+	template <class VolumeType>
+	class TransformBackwardKernel {
+		protected:
+		VolumeType& tmpl;
+		SymTensor3DVolume *out;
+		
+		public:
+		TransformBackwardKernel (VolumeType& tmpl, const SymTensor3DVolume& space) : tmpl(tmpl) {
+			out = copyOf(space);
+		}
+		
+		~TransformBackwardKernel () {
+			delete out;
+		}
+		
+		void prepare () {}
+		
+		double run () {
+			tmpl.computeTransform(*out);
+			return computeChecksum(*out);
+		}
+	};
+	
+	class SquaringKernel {
+		protected:
+		const DeformationField3D& src;
+		DeformationField3D *work;
+		const int iterations;
+		
+		public:
+		SquaringKernel (const DeformationField3D& src, const int iterations) : src(src), iterations(iterations) {
+			work = copyOf(src);
+		}
+		
+		~SquaringKernel () {
+			delete work;
+		}
+		
+		void prepare () {
+			*work = src;
+		}
+		
+		double run () {
+			work->squaring(iterations);
+			return computeChecksum(*work);
+		}
+	};
+	
+	class InverseKernel {
+		protected:
+		const DeformationField3D& field;
+		
+		public:
+		InverseKernel (const DeformationField3D& field) : field(field) {}
+		
+		void prepare () {}
+		
+		double run () {
+			DeformationField3D *inv = field.computeInverse();
+			const double sum = computeChecksum(*inv);
+			delete inv;
+			return sum;
+		}
+	};
+	
+	class NiftiWriteKernel {
+		protected:
+		SymTensor3DVolume& vol;
+		const string filename;
+		
+		public:
+		NiftiWriteKernel (SymTensor3DVolume& vol, const string& filename) : vol(vol), filename(filename) {}
+		
+		void prepare () {}
+		
+		double run () {
+			vol.writeVolAs(filename.c_str());
+			return 0.0;
+		}
+	};
+	
+	class NiftiReadKernel {
+		protected:
+		const string filename;
+		
+		public:
+		NiftiReadKernel (const string& filename) : filename(filename) {}
+		
+		void prepare () {}
+		
+		double run () {
+			SymTensor3DVolume in(filename.c_str());
+			return computeChecksum(in);
+		}
+	};
+	
+	class KernelBenchmark {
+		protected:
+		vector< vector<int> > sizes;
+		vector<int> threads;
+		int repeats;
+		int noOfPoints;
+		double vsize[3];
+		string tmpDir;
+		unsigned long long seed;
+		
+		// uniform in [-1, 1), reproducible from the seed
+		static double uniform (unsigned long long& state) {
+			state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+			return (state >> 11) * (2.0 / 9007199254740992.0) - 1.0;
+		}
+		
+		// the parameters of a random affine around the identity, as
+		// taken by Affine3D::setQS
+		static void buildAffine (unsigned long long& state, double para[12]) {
+			for (int m = 0; m < 3; ++m) {
+				para[m] = 2.0 * uniform(state);
+				para[3 + m] = 0.05 * uniform(state);
+				para[6 + m] = 1.0 + 0.05 * uniform(state);
+				para[9 + m] = 0.02 * uniform(state);
+			}
+		}
+		
+		// a random affine in each cell of a 4x4x4 grid over the volume
+		void buildPiecewise (PiecewiseAffine3D& pa, const VoxelSpace& space, unsigned long long& state) const {
+			int sz[3];
+			space.getSize(sz);
+			const int cells[3] = {4, 4, 4};
+			double cellSize[3];
+			for (int m = 0; m < 3; ++m) {
+				cellSize[m] = sz[m] * vsize[m] / cells[m];
+			}
+			pa.configure(cells, cellSize);
+			double para[12];
+			for (int i = 0; i < cells[0]; ++i) {
+				for (int j = 0; j < cells[1]; ++j) {
+					for (int k = 0; k < cells[2]; ++k) {
+						Vector3D center((i + 0.5) * cellSize[0], (j + 0.5) * cellSize[1], (k + 0.5) * cellSize[2]);
+						buildAffine(state, para);
+						Affine3D aff;
+						aff.setQS(para, center);
+						pa.setAffineAt(i, j, k, aff);
+					}
+				}
+			}
+		}
+		
+		void record (BenchmarkReport& report, BenchmarkResult res, const string& kernel, const string& variant,
+			const int sz[3], const int t, const unsigned long long voxels) const {
+			res.kernel = kernel;
+			res.variant = variant;
+			for (int m = 0; m < 3; ++m) {
+				res.size[m] = sz[m];
+			}
+			res.threads = t;
+			res.voxels = voxels;
+			cout << "benchmark " << res.getKey() << ": best " << res.best << 's' << endl;
+			report.add(res);
+		}
+		
+		// a smooth displacement of up to 1.5 voxels
+		void buildDeformation (DeformationField3D& field, const int sz[3], unsigned long long& state) const {
+			const double pi = 3.14159265358979323846;
+			double amp[3];
+			double phase[3];
+			for (int m = 0; m < 3; ++m) {
+				amp[m] = vsize[m] * (1.0 + 0.5 * uniform(state));
+				phase[m] = pi * uniform(state);
+			}
+			for (int i = 0; i < sz[0]; ++i) {
+				const double x = 2.0 * pi * i / sz[0];
+				for (int j = 0; j < sz[1]; ++j) {
+					const double y = 2.0 * pi * j / sz[1];
+					for (int k = 0; k < sz[2]; ++k) {
+						const double z = 2.0 * pi * k / sz[2];
+						field.voxel[i][j][k].set(
+							amp[0] * sin(y + phase[0]) * sin(z + phase[1]),
+							amp[1] * sin(z + phase[1]) * sin(x + phase[2]),
+							amp[2] * sin(x + phase[2]) * sin(y + phase[0]));
+					}
+				}
+			}
+		}
+		
+		void runSize (BenchmarkReport& report, const int sz[3]) const {
+			const unsigned long long voxels = (unsigned long long)sz[0] * sz[1] * sz[2];
+			const double eigs[3] = {1.5, 0.4, 0.4};
+			Line line(sz, vsize, eigs, 0.1, 0.1, 0.0, false);
+			Sheet sheet(sz, vsize, eigs, 0.5, 0.1, 0.1, 0.0, false);
+			line.buildBSplineCoefficients();
+			
+			double org[3];
+			line.getOrigin(org);
+			unsigned long long state = seed;
+			
+			// the transform volumes are filled through their Volume
+			// base, the synthetic volumes being of another type
+			AffineSymTensor3DVolume tmpl(sz);
+			tmpl.setVSize(vsize);
+			tmpl.setOrigin(org);
+			static_cast<Volume<SymTensor3D>&>(tmpl) = line;
+			double para[12];
+			buildAffine(state, para);
+			tmpl.setTransformationAndGrad(para);
+			
+			PiecewiseAffineSymTensor3DVolume piecewise(sz);
+			piecewise.setVSize(vsize);
+			piecewise.setOrigin(org);
+			static_cast<Volume<SymTensor3D>&>(piecewise) = line;
+			PiecewiseAffine3D pa;
+			buildPiecewise(pa, line, state);
+			piecewise.setTransformation(pa);
+			
+			SymTensor3DVolume subj(sz, true);
+			subj.setVSize(vsize);
+			subj.setOrigin(org);
+			static_cast<Volume<SymTensor3D>&>(subj) = sheet;
+			subj.buildGradient();
+			
+			DeformationField3D field(sz);
+			field.setVSize(vsize);
+			field.setOrigin(org);
+			buildDeformation(field, sz, state);
+			
+			ostringstream oss;
+			oss << tmpDir << "/dtitk_benchmark_" << getpid() << '_' << sz[0] << 'x' << sz[1] << 'x' << sz[2];
+			const string filename = oss.str() + ".nii.gz";
+			
+			// the deformation volume only reads its field from a file
+			const string dfFilename = oss.str() + ".df.nii.gz";
+			field.writeVolAs(dfFilename.c_str());
+			DeformationSymTensor3DVolume deformed(sz);
+			deformed.setVSize(vsize);
+			deformed.setOrigin(org);
+			static_cast<Volume<SymTensor3D>&>(deformed) = line;
+			deformed.setTransformation(dfFilename.c_str());
+			remove(dfFilename.c_str());
+			
+			for (size_t t = 0; t < threads.size(); ++t) {
+#ifdef _OPENMP
+				omp_set_num_threads(threads[t]);
+#else
+				if (threads[t] != 1) {
+					continue;
+				}
+#endif
+				{
+					InterpolationKernel kernel(line, noOfPoints, 0);
+					record(report, measure(kernel, repeats), "interpolation", "trilinear", sz, threads[t], noOfPoints);
+				}
+				{
+					InterpolationKernel kernel(line, noOfPoints, 2);
+					record(report, measure(kernel, repeats), "interpolation", "bspline", sz, threads[t], noOfPoints);
+				}
+				{
+					SmoothingKernel kernel(line);
+					record(report, measure(kernel, repeats), "gaussianSmoothing", "sigma=1", sz, threads[t], voxels);
+				}
+				const SymTensor3D::SimilarityMeasure sms[3] = {SymTensor3D::EDS, SymTensor3D::GDS, SymTensor3D::DDS};
+				const char *smNames[3] = {"EDS", "GDS", "DDS"};
+				for (int s = 0; s < 3; ++s) {
+					SimilarityGradientKernel kernel(tmpl, subj, sms[s]);
+					record(report, measure(kernel, repeats), "similarityGradient", smNames[s], sz, threads[t], voxels);
+				}
+				{
+					TransformBackwardKernel<AffineSymTensor3DVolume> kernel(tmpl, line);
+					record(report, measure(kernel, repeats), "transformBackward", "affine", sz, threads[t], voxels);
+				}
+				{
+					TransformBackwardKernel<PiecewiseAffineSymTensor3DVolume> kernel(piecewise, line);
+					record(report, measure(kernel, repeats), "transformBackward", "piecewiseAffine", sz, threads[t], voxels);
+				}
+				{
+					TransformBackwardKernel<DeformationSymTensor3DVolume> kernel(deformed, line);
+					record(report, measure(kernel, repeats), "transformBackward", "deformation", sz, threads[t], voxels);
+				}
+				{
+					SquaringKernel kernel(field, 6);
+					record(report, measure(kernel, repeats), "squaring", "iterations=6", sz, threads[t], voxels);
+				}
+				{
+					InverseKernel kernel(field);
+					record(report, measure(kernel, repeats), "inverse", "deformation", sz, threads[t], voxels);
+				}
+				{
+					NiftiWriteKernel kernel(line, filename);
+					record(report, measure(kernel, repeats), "niftiWrite", "tensor", sz, threads[t], voxels);
+				}
+				{
+					NiftiReadKernel kernel(filename);
+					record(report, measure(kernel, repeats), "niftiRead", "tensor", sz, threads[t], voxels);
+				}
+			}
+			remove(filename.c_str());
+		}
+		
+		public:
+		KernelBenchmark () {
+			repeats = 3;
+			noOfPoints = 1000000;
+			vsize[0] = vsize[1] = vsize[2] = 1.0;
+			tmpDir = "/tmp";
+			seed = 1;
+		}
+		
+		void addSize (const int sz[3]) {
+			sizes.push_back(vector<int>(sz, sz + 3));
+		}
+		
+		void addThreads (const int n) {
+			threads.push_back(n);
+		}
+		
+		void setRepeats (const int n) {
+			repeats = n;
+		}
+		
+		// the number of points of the interpolation kernels
+		void setNoOfPoints (const int n) {
+			noOfPoints = n;
+		}
+		
+		void setVSize (const double in[3]) {
+			for (int m = 0; m < 3; ++m) {
+				vsize[m] = in[m];
+			}
+		}
+		
+		// the seed of the random transformations
+		void setSeed (const unsigned long long in) {
+			seed = in;
+		}
+		
+		// where the nifti kernels write their file
+		void setTemporaryDirectory (const char *dir) {
+			tmpDir = dir;
+		}
+		
+		void run (BenchmarkReport& report) {
+			if (sizes.size() == 0) {
+				const int sz[3] = {64, 64, 64};
+				addSize(sz);
+			}
+			if (threads.size() == 0) {
+				addThreads(1);
+			}
+			for (size_t s = 0; s < sizes.size(); ++s) {
+				runSize(report, &sizes[s][0]);
+			}
+		}
+	};
+
+}
+
+#endif
@@ -0,0 +1,509 @@
+/*============================================================================
+
+  Program:     DTI ToolKit (DTI-TK)
+  Module:      $RCSfile: RegistrationBenchmark.h,v $
+  Language:    C++
+  Date:        $Date: 2026/10/18 19:12:48 $
+  Version:     $Revision: 1.1 $
+
+  Copyright (c) Gary Hui Zhang (garyhuizhang@gmail.com).
+  All rights reserverd.
+
+  DTI-TK is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  DTI-TK is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with DTI-TK.  If not, see <http://www.gnu.org/licenses/>.
+============================================================================*/
+
+
+// class RegistrationBenchmark
+//
+// declaration and implementation
+//
+// end-to-end registration with known answers.  every subject is the
+// template warped by a ground truth map phi = A o D, A a random affine
+// and D a random smooth deformation, i.e. subject(x) = template(phi(x))
+// with the tensors reoriented.  the subject is then registered back to
+// the template with the usual scripts:
+//
+//   rigid    dti_rigid_reg
+//   affine   dti_affine_reg, starting from the rigid result
+//   diffeo   dti_diffeomorphic_reg on the affine result, followed by
+//            dfRightComposeAffine
+//
+// a stage recovering psi warps the subject to subject(psi(x)), which is
+// template(phi(psi(x))); the error of psi is |phi(psi(x)) - x| over the
+// mask, reported as its mean and maximum in mm.  the warped subject is
+// also compared to the template with getAveragedEEPairsOverlap and
+// getFAWeightedAverageOfAngleOfPDs.  with the wall time of every stage,
+// runs with different thread counts, precision modes or sampling (set
+// through setEnvironment and told apart by the label) can be compared on
+// both speed and accuracy.
+//
+// a stage whose command fails is recorded as failed, with its wall time
+// and no errors, and the later stages of that subject, which start from
+// its output, are skipped; the other subjects are still run.
+//
+// the template is either supplied, with its mask, or a synthetic Line.
+// the scripts require DTITK_ROOT, and the diffeomorphic stage the usual
+// template dimensions.
+
+#ifndef _benchmark_RegistrationBenchmark_H
+#define _benchmark_RegistrationBenchmark_H
+
+#include "Benchmark.h"
+#include "../synthetic/Line.h"
+#include "../geometry/Affine3D.h"
+#include "../volume/ScalarVolume.h"
+#include "../volume/DeformationField3D.h"
+#include "../volume/DeformationSymTensor3DVolume.h"
+
+namespace benchmark {
+	
+	using namespace geometry;
+	using namespace volume;
+	using namespace synthetic;
+	
+	struct RegistrationResult {
+		string label;
+		string subject;
+		string stage;
+		double time;
+		double meanError;
+		double maxError;
+		double overlap;
+		double angle[2];
+		bool failed;
+	};
+	
+	class RegistrationBenchmark {
+		protected:
+		string workDir;
+		string templateFile;
+		string maskFile;
+		string label;
+		string smOption;
+		double sep[3];
+		double ftol;
+		int diffeoIterations;
+		int noOfSubjects;
+		unsigned long long seed;
+		double faThreshold;
+		
+		// the magnitude of the ground truth transformations
+		double affineMagnitude;
+		double deformationMagnitude;
+		
+		vector<RegistrationResult> results;
+		
+		// uniform in [-1, 1), reproducible from the seed
+		static double uniform (unsigned long long& state) {
+			state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+			return (state >> 11) * (2.0 / 9007199254740992.0) - 1.0;
+		}
+		
+		// a path as a single argument of the shell
+		static string quote (const string& in) {
+			string out = "'";
+			for (size_t c = 0; c < in.size(); ++c) {
+				if (in[c] == '\'') {
+					out += "'\\''";
+				} else {
+					out += in[c];
+				}
+			}
+			return out + "'";
+		}
+		
+		// run a command, adding its wall time to time; false if it failed
+		static bool runCommand (const string& cmd, double& time) {
+			cout << cmd << endl;
+			const double t1 = io::Profiler::getWallTime();
+			const int status = system(cmd.c_str());
+			const double t2 = io::Profiler::getWallTime();
+			time += t2 - t1;
+			if (status != 0) {
+				cerr << "Command failed: " << cmd << endl;
+				return false;
+			}
+			return true;
+		}
+		
+		string getFilename (const string& base) const {
+			return workDir + "/" + base;
+		}
+		
+		// phi = A o D as a displacement field over the template
+		void buildGroundTruth (const VoxelSpace& space, unsigned long long& state, DeformationField3D& phi) const {
+			int sz[3];
+			double vsz[3];
+			space.getSize(sz);
+			space.getVSize(vsz);
+			
+			// the affine about the center of the volume
+			Vector3D center(0.5 * (sz[0] - 1), 0.5 * (sz[1] - 1), 0.5 * (sz[2] - 1));
+			space.toAbs(center);
+			double para[12];
+			for (int m = 0; m < 3; ++m) {
+				para[m] = 2.0 * affineMagnitude * uniform(state);
+				para[3 + m] = 0.05 * affineMagnitude * uniform(state);
+				para[6 + m] = 1.0 + 0.05 * affineMagnitude * uniform(state);
+				para[9 + m] = 0.02 * affineMagnitude * uniform(state);
+			}
+			Affine3D aff;
+			aff.setQS(para, center);
+			
+			// the deformation, a few voxels of smooth sinusoids
+			const double pi = 3.14159265358979323846;
+			double amp[3];
+			double phase[3];
+			for (int m = 0; m < 3; ++m) {
+				amp[m] = deformationMagnitude * vsz[m] * (1.0 + 0.5 * uniform(state));
+				phase[m] = pi * uniform(state);
+			}
+			
+			Vector3D vec;
+			Vector3D out;
+			for (int i = 0; i < sz[0]; ++i) {
+				const double x = 2.0 * pi * i / sz[0];
+				for (int j = 0; j < sz[1]; ++j) {
+					const double y = 2.0 * pi * j / sz[1];
+					for (int k = 0; k < sz[2]; ++k) {
+						const double z = 2.0 * pi * k / sz[2];
+						vec.set(i, j, k);
+						space.toAbs(vec);
+						out.set(amp[0] * sin(y + phase[0]) * sin(z + phase[1]),
+							amp[1] * sin(z + phase[1]) * sin(x + phase[2]),
+							amp[2] * sin(x + phase[2]) * sin(y + phase[0]));
+						out += vec;
+						out *= aff;
+						out -= vec;
+						phi.voxel[i][j][k] = out;
+					}
+				}
+			}
+		}
+		
+		// the mean and maximum of |phi(psi(x)) - x| over the mask
+		template <class Transform>
+		static void computeError (const DeformationField3D& phi, const Transform& psi,
+			const Volume<double>& mask, double& mean, double& max) {
+			int sz[3];
+			mask.getSize(sz);
+			Vector3D vec;
+			Vector3D out;
+			double sum = 0.0;
+			int count = 0;
+			max = 0.0;
+			for (int i = 0; i < sz[0]; ++i) {
+				for (int j = 0; j < sz[1]; ++j) {
+					for (int k = 0; k < sz[2]; ++k) {
+						if ((int)(mask.voxel[i][j][k]) == 0) {
+							continue;
+						}
+						vec.set(i, j, k);
+						mask.toAbs(vec);
+						out = vec;
+						out *= psi;
+						out *= phi;
+						out -= vec;
+						const double err = sqrt(out[0] * out[0] + out[1] * out[1] + out[2] * out[2]);
+						sum += err;
+						if (err > max) {
+							max = err;
+						}
+						++count;
+					}
+				}
+			}
+			mean = count > 0 ? sum / count : 0.0;
+		}
+		
+		void addResult (const string& subject, const string& stage, const double time,
+			const double error[2], const SymTensor3DVolume& tmpl, const char *warped, const ScalarVolume& mask) {
+			SymTensor3DVolume in(warped);
+			RegistrationResult res;
+			res.label = label;
+			res.subject = subject;
+			res.stage = stage;
+			res.time = time;
+			res.meanError = error[0];
+			res.maxError = error[1];
+			res.overlap = tmpl.getAveragedEEPairsOverlap(in, mask, faThreshold);
+			tmpl.getFAWeightedAverageOfAngleOfPDs(in, mask, faThreshold, res.angle);
+			res.failed = false;
+			results.push_back(res);
+		}
+		
+		void addFailure (const string& subject, const string& stage, const double time) {
+			RegistrationResult res;
+			res.label = label;
+			res.subject = subject;
+			res.stage = stage;
+			res.time = time;
+			res.meanError = res.maxError = res.overlap = 0.0;
+			res.angle[0] = res.angle[1] = 0.0;
+			res.failed = true;
+			results.push_back(res);
+		}
+		
+		void writeSyntheticTemplate () {
+			const int sz[3] = {128, 128, 64};
+			const double vsz[3] = {1.5, 1.75, 2.25};
+			const double eigs[3] = {1.5, 0.4, 0.4};
+			Line line(sz, vsz, eigs, 0.1, 0.1, 0.0, false);
+			templateFile = getFilename("template.nii.gz");
+			line.writeVolAs(templateFile.c_str());
+			
+			ScalarVolume mask(sz);
+			mask.setVSize(vsz);
+			for (int i = 0; i < sz[0]; ++i) {
+				for (int j = 0; j < sz[1]; ++j) {
+					for (int k = 0; k < sz[2]; ++k) {
+						mask.voxel[i][j][k] = 1.0;
+					}
+				}
+			}
+			maskFile = getFilename("mask.nii.gz");
+			mask.writeVolAs(maskFile.c_str());
+		}
+		
+		public:
+		RegistrationBenchmark (const char *dir) : workDir(dir) {
+			smOption = "EDS";
+			sep[0] = sep[1] = sep[2] = 4.0;
+			ftol = 0.01;
+			diffeoIterations = 6;
+			noOfSubjects = 4;
+			seed = 1;
+			faThreshold = 0.2;
+			affineMagnitude = 1.0;
+			deformationMagnitude = 1.0;
+		}
+		
+		// without a template, a synthetic one is written to the work directory
+		void setTemplate (const char *tmpl, const char *mask) {
+			templateFile = tmpl;
+			maskFile = mask;
+		}
+		
+		// identifies the configuration in the results
+		void setLabel (const char *in) {
+			label = in;
+		}
+		
+		// e.g. OMP_NUM_THREADS, or the options of the registration tools
+		void setEnvironment (const char *name, const char *value) {
+			setenv(name, value, 1);
+		}
+		
+		void setSMOption (const char *in) {
+			smOption = in;
+		}
+		
+		void setSeparation (const double in[3]) {
+			for (int m = 0; m < 3; ++m) {
+				sep[m] = in[m];
+			}
+		}
+		
+		void setFTol (const double in) {
+			ftol = in;
+		}
+		
+		void setNoOfDiffeomorphicIterations (const int in) {
+			diffeoIterations = in;
+		}
+		
+		void setNoOfSubjects (const int in) {
+			noOfSubjects = in;
+		}
+		
+		void setSeed (const unsigned long long in) {
+			seed = in;
+		}
+		
+		void setFAThreshold (const double in) {
+			faThreshold = in;
+		}
+		
+		// 1 for translations of up to 2mm, rotations of 0.05 rad,
+		// scalings of 5% and deformations of a voxel
+		void setMagnitude (const double affine, const double deformation) {
+			affineMagnitude = affine;
+			deformationMagnitude = deformation;
+		}
+		
+		const vector<RegistrationResult>& getResults () const {
+			return results;
+		}
+		
+		void run () {
+			if (templateFile.size() == 0) {
+				writeSyntheticTemplate();
+			}
+			SymTensor3DVolume tmpl(templateFile.c_str());
+			ScalarVolume mask(maskFile.c_str());
+			int sz[3];
+			double vsz[3];
+			double org[3];
+			tmpl.getSize(sz);
+			tmpl.getVSize(vsz);
+			tmpl.getOrigin(org);
+			
+			const string tmplArg = quote(templateFile);
+			ostringstream oss;
+			oss << " " << smOption << " " << sep[0] << " " << sep[1] << " " << sep[2] << " " << ftol;
+			const string regOptions = oss.str();
+			
+			unsigned long long state = seed;
+			for (int s = 0; s < noOfSubjects; ++s) {
+				ostringstream name;
+				name << "subject" << s;
+				const string subject = name.str();
+				const string pref = getFilename(subject);
+				
+				// the ground truth and the subject
+				DeformationField3D phi(sz);
+				phi.setVSize(vsz);
+				phi.setOrigin(org);
+				buildGroundTruth(tmpl, state, phi);
+				const string phiFile = pref + "_truth.df.nii.gz";
+				phi.writeVolAs(phiFile.c_str());
+				{
+					DeformationSymTensor3DVolume warp(templateFile.c_str());
+					warp.setTransformation(phiFile.c_str());
+					SymTensor3DVolume out(sz);
+					out.setVSize(vsz);
+					out.setOrigin(org);
+					warp.computeTransform(out);
+					out.writeVolAs((pref + ".nii.gz").c_str());
+				}
+				
+				const string subjArg = quote(pref + ".nii.gz");
+				double error[2];
+				double time = 0.0;
+				if (!runCommand("dti_rigid_reg " + tmplArg + " " + subjArg + regOptions, time)) {
+					addFailure(subject, "rigid", time);
+					continue;
+				}
+				{
+					Affine3D aff((pref + ".aff").c_str());
+					computeError(phi, aff, mask, error[0], error[1]);
+				}
+				addResult(subject, "rigid", time, error, tmpl, (pref + "_aff.nii.gz").c_str(), mask);
+				
+				time = 0.0;
+				if (!runCommand("dti_affine_reg " + tmplArg + " " + subjArg + regOptions + " 1", time)) {
+					addFailure(subject, "affine", time);
+					continue;
+				}
+				{
+					Affine3D aff((pref + ".aff").c_str());
+					computeError(phi, aff, mask, error[0], error[1]);
+				}
+				addResult(subject, "affine", time, error, tmpl, (pref + "_aff.nii.gz").c_str(), mask);
+				
+				ostringstream diffeo;
+				diffeo << "dti_diffeomorphic_reg " << tmplArg << " " << quote(pref + "_aff.nii.gz") << " ";
+				diffeo << quote(maskFile) << " 1 " << diffeoIterations << " " << ftol;
+				const string combined = pref + "_combined.df.nii.gz";
+				ostringstream compose;
+				compose << "dfRightComposeAffine -aff " << quote(pref + ".aff");
+				compose << " -df " << quote(pref + "_aff_diffeo.df.nii.gz") << " -out " << quote(combined);
+				time = 0.0;
+				if (!runCommand(diffeo.str(), time) || !runCommand(compose.str(), time)) {
+					addFailure(subject, "diffeo", time);
+					continue;
+				}
+				{
+					DeformationField3D psi(combined.c_str());
+					computeError(phi, psi, mask, error[0], error[1]);
+				}
+				addResult(subject, "diffeo", time, error, tmpl, (pref + "_aff_diffeo.nii.gz").c_str(), mask);
+			}
+		}
+		
+		// the number of failed stages
+		int getNoOfFailures () const {
+			int n = 0;
+			for (size_t r = 0; r < results.size(); ++r) {
+				if (results[r].failed) {
+					++n;
+				}
+			}
+			return n;
+		}
+		
+		void writeCSV (ostream& out) const {
+			out << "label,subject,stage,status,time,mean_error,max_error,ee_overlap,pd_angle_mean,pd_angle_std" << endl;
+			out << setprecision(10);
+			for (size_t r = 0; r < results.size(); ++r) {
+				const RegistrationResult& res = results[r];
+				out << res.label << ',' << res.subject << ',' << res.stage << ',';
+				out << (res.failed ? "failed" : "ok") << ',' << res.time;
+				if (res.failed) {
+					out << ",,,,," << endl;
+					continue;
+				}
+				out << ',' << res.meanError << ',' << res.maxError << ',' << res.overlap << ',';
+				out << res.angle[0] << ',' << res.angle[1] << endl;
+			}
+		}
+		
+		void writeJSON (ostream& out) const {
+			out << setprecision(10);
+			out << "[";
+			for (size_t r = 0; r < results.size(); ++r) {
+				const RegistrationResult& res = results[r];
+				out << (r == 0 ? "" : ",") << endl;
+				out << "  {\"label\": \"" << res.label << "\"";
+				out << ", \"subject\": \"" << res.subject << "\"";
+				out << ", \"stage\": \"" << res.stage << "\"";
+				out << ", \"status\": \"" << (res.failed ? "failed" : "ok") << "\"";
+				out << ", \"time\": " << res.time;
+				if (res.failed) {
+					out << "}";
+					continue;
+				}
+				out << ", \"mean_error\": " << res.meanError;
+				out << ", \"max_error\": " << res.maxError;
+				out << ", \"ee_overlap\": " << res.overlap;
+				out << ", \"pd_angle_mean\": " << res.angle[0];
+				out << ", \"pd_angle_std\": " << res.angle[1] << "}";
+			}
+			out << endl << "]" << endl;
+		}
+		
+		bool writeCSV (const char *filename) const {
+			ofstream out(filename);
+			if (!out) {
+				cerr << "Fail to write the benchmark results to " << filename << endl;
+				return false;
+			}
+			writeCSV(out);
+			return true;
+		}
+		
+		bool writeJSON (const char *filename) const {
+			ofstream out(filename);
+			if (!out) {
+				cerr << "Fail to write the benchmark results to " << filename << endl;
+				return false;
+			}
+			writeJSON(out);
+			return true;
+		}
+	};
+
+}
+
+#endif
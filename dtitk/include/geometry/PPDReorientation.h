@@ -0,0 +1,251 @@
+/*============================================================================
+
+  Program:     DTI ToolKit (DTI-TK)
+  Module:      $RCSfile: PPDReorientation.h,v $
+  Language:    C++
+  Date:        $Date: 2026/10/18 22:20:48 $
+  Version:     $Revision: 1.1 $
+
+  Copyright (c) Gary Hui Zhang (garyhuizhang@gmail.com).
+  All rights reserverd.
+
+  DTI-TK is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  DTI-TK is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with DTI-TK.  If not, see <http://www.gnu.org/licenses/>.
+============================================================================*/
+
+
+// class PPDReorientation
+//
+// declaration and implementation
+//
+// preservation of principal directions (PPD) with the rotations built
+// in closed form as quaternions.  for a tensor with principal and second
+// eigenvectors e1 and e2 and a local transformation F:
+//
+//   n1 = F e1 / |F e1|
+//   R1 = the rotation of e1 onto n1
+//   n2 = F e2 projected perpendicular to n1, normalized
+//   R2 = the rotation about n1 of R1 e2 onto n2
+//
+// and the tensor is reoriented by R = R2 R1.  the rotation of a unit
+// vector a onto a unit vector b is the quaternion (1 + a.b, a x b)
+// normalized, so no angle nor axis is computed.
+//
+// the tensor is rebuilt from its eigensystem with the rotated
+// eigenvectors, so a tensor is decomposed once.  with LEI, the
+// interpolated tensor is a log tensor with the same eigenvectors: the
+// exponential and the reorientation share that decomposition
+// (reorientLog), instead of one decomposition for exp and another for
+// the reorientation.
+//
+// F is the matrix handed to SymTensor3D::PPDTransformByEqual, that is
+// the inverse of the jacobian of the inverse transformation for backward
+// resampling.  the resampling paths keep PPDTransformByEqual until this
+// kernel has been checked against it on random tensors, degenerate
+// eigenvalues included.
+
+#ifndef _geometry_PPDReorientation_H
+#define _geometry_PPDReorientation_H
+
+#include "SymTensor3D.h"
+#include "Matrix3D.h"
+#include "Vector3D.h"
+#include <cmath>
+
+namespace geometry {
+	
+	class PPDReorientation {
+		public:
+		// the quaternion (w, x, y, z) of the rotation of the unit vector a
+		// onto the unit vector b; opposite vectors are rotated by pi
+		// about an axis perpendicular to a
+		static void computeRotationBetween (const double a[3], const double b[3], double q[4]) {
+			q[0] = 1.0 + a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+			q[1] = a[1] * b[2] - a[2] * b[1];
+			q[2] = a[2] * b[0] - a[0] * b[2];
+			q[3] = a[0] * b[1] - a[1] * b[0];
+			if (q[0] < 1e-12) {
+				// any axis perpendicular to a
+				q[0] = 0.0;
+				if (fabs(a[0]) < 0.9) {
+					q[1] = 0.0;
+					q[2] = a[2];
+					q[3] = -a[1];
+				} else {
+					q[1] = -a[2];
+					q[2] = 0.0;
+					q[3] = a[0];
+				}
+			}
+			normalize(q, 4);
+		}
+		
+		// out = q in q*, in closed form
+		static void rotate (const double q[4], const double in[3], double out[3]) {
+			// t = 2 (u x in), out = in + w t + u x t
+			const double t[3] = {
+				2.0 * (q[2] * in[2] - q[3] * in[1]),
+				2.0 * (q[3] * in[0] - q[1] * in[2]),
+				2.0 * (q[1] * in[1] - q[2] * in[0])
+			};
+			out[0] = in[0] + q[0] * t[0] + q[2] * t[2] - q[3] * t[1];
+			out[1] = in[1] + q[0] * t[1] + q[3] * t[0] - q[1] * t[2];
+			out[2] = in[2] + q[0] * t[2] + q[1] * t[1] - q[2] * t[0];
+		}
+		
+		// out = lhs rhs, the rotation rhs followed by lhs
+		static void multiply (const double lhs[4], const double rhs[4], double out[4]) {
+			out[0] = lhs[0] * rhs[0] - lhs[1] * rhs[1] - lhs[2] * rhs[2] - lhs[3] * rhs[3];
+			out[1] = lhs[0] * rhs[1] + lhs[1] * rhs[0] + lhs[2] * rhs[3] - lhs[3] * rhs[2];
+			out[2] = lhs[0] * rhs[2] - lhs[1] * rhs[3] + lhs[2] * rhs[0] + lhs[3] * rhs[1];
+			out[3] = lhs[0] * rhs[3] + lhs[1] * rhs[2] - lhs[2] * rhs[1] + lhs[3] * rhs[0];
+		}
+		
+		// the PPD rotation of the eigenvectors e1, e2 under f
+		static void computeRotation (const double f[3][3], const double e1[3], const double e2[3], double q[4]) {
+			double n1[3], n2[3], r1e2[3], q1[4], q2[4];
+			transform(f, e1, n1);
+			transform(f, e2, n2);
+			if (!normalize(n1, 3)) {
+				q[0] = 1.0;
+				q[1] = q[2] = q[3] = 0.0;
+				return;
+			}
+			computeRotationBetween(e1, n1, q1);
+			
+			// the part of F e2 perpendicular to n1
+			const double proj = n1[0] * n2[0] + n1[1] * n2[1] + n1[2] * n2[2];
+			for (int m = 0; m < 3; ++m) {
+				n2[m] -= proj * n1[m];
+			}
+			if (!normalize(n2, 3)) {
+				for (int m = 0; m < 4; ++m) {
+					q[m] = q1[m];
+				}
+				return;
+			}
+			rotate(q1, e2, r1e2);
+			computeRotationBetween(r1e2, n2, q2);
+			multiply(q2, q1, q);
+		}
+		
+		// the tensor with the eigenvalues eigs and the eigenvectors
+		// eigv[m] rotated by q
+		static void compose (const double eigs[3], const double eigv[3][3], const double q[4], SymTensor3D& out) {
+			double v[3][3];
+			for (int m = 0; m < 3; ++m) {
+				rotate(q, eigv[m], v[m]);
+			}
+			double d[6] = {0.0, 0.0, 0.0, 0.0, 0.0, 0.0};
+			for (int m = 0; m < 3; ++m) {
+				d[0] += eigs[m] * v[m][0] * v[m][0];
+				d[1] += eigs[m] * v[m][1] * v[m][0];
+				d[2] += eigs[m] * v[m][1] * v[m][1];
+				d[3] += eigs[m] * v[m][2] * v[m][0];
+				d[4] += eigs[m] * v[m][2] * v[m][1];
+				d[5] += eigs[m] * v[m][2] * v[m][2];
+			}
+			out.set(d[0], d[1], d[2], d[3], d[4], d[5]);
+		}
+		
+		// PPD of a tensor from its eigensystem, the eigenvalues in any
+		// order; with useExp, the tensor is a log tensor and the result
+		// its exponential
+		static void reorient (const double f[3][3], double eigs[3], double eigv[3][3], SymTensor3D& out, const bool useExp = false) {
+			int first = 0;
+			for (int m = 1; m < 3; ++m) {
+				if (eigs[m] > eigs[first]) {
+					first = m;
+				}
+			}
+			int second = (first == 0) ? 1 : 0;
+			for (int m = 0; m < 3; ++m) {
+				if (m != first && eigs[m] > eigs[second]) {
+					second = m;
+				}
+			}
+			double q[4];
+			computeRotation(f, eigv[first], eigv[second], q);
+			if (useExp) {
+				for (int m = 0; m < 3; ++m) {
+					eigs[m] = exp(eigs[m]);
+				}
+			}
+			compose(eigs, eigv, q, out);
+		}
+		
+		static void reorient (const double f[3][3], SymTensor3D& tensor) {
+			double eigs[3], eigv[3][3];
+			getEigenSystem(tensor, eigs, eigv);
+			reorient(f, eigs, eigv, tensor);
+		}
+		
+		// the exponential of a log tensor, then its PPD reorientation
+		static void reorientLog (const double f[3][3], SymTensor3D& logTensor) {
+			double eigs[3], eigv[3][3];
+			getEigenSystem(logTensor, eigs, eigv);
+			reorient(f, eigs, eigv, logTensor, true);
+		}
+		
+		// n tensors reoriented by the same matrix, e.g. an affine
+		static void reorient (const Matrix3D& mat, SymTensor3D *tensors, const int n) {
+			double f[3][3];
+			getMatrix(mat, f);
+			for (int t = 0; t < n; ++t) {
+				reorient(f, tensors[t]);
+			}
+		}
+		
+		static void getMatrix (const Matrix3D& mat, double f[3][3]) {
+			for (int m = 0; m < 3; ++m) {
+				for (int n = 0; n < 3; ++n) {
+					f[m][n] = mat.getElement(m, n);
+				}
+			}
+		}
+		
+		protected:
+		static void getEigenSystem (const SymTensor3D& tensor, double eigs[3], double eigv[3][3]) {
+			Vector3D vec[3];
+			tensor.getEigenSystem(eigs, vec);
+			for (int m = 0; m < 3; ++m) {
+				for (int n = 0; n < 3; ++n) {
+					eigv[m][n] = vec[m][n];
+				}
+			}
+		}
+		
+		static void transform (const double f[3][3], const double in[3], double out[3]) {
+			for (int m = 0; m < 3; ++m) {
+				out[m] = f[m][0] * in[0] + f[m][1] * in[1] + f[m][2] * in[2];
+			}
+		}
+		
+		static bool normalize (double *v, const int n) {
+			double norm = 0.0;
+			for (int m = 0; m < n; ++m) {
+				norm += v[m] * v[m];
+			}
+			if (norm < 1e-30) {
+				return false;
+			}
+			norm = sqrt(norm);
+			for (int m = 0; m < n; ++m) {
+				v[m] /= norm;
+			}
+			return true;
+		}
+	};
+}
+
+#endif
@@ -98,6 +98,11 @@ namespace geometry {
 			return matrix[index];
 		}
 		
+		// array-like indexing for const SymTensor3D
+		inline const double& operator[] (int index) const {
+			return matrix[index];
+		}
+		
 		// interface to different similarity measures
 		double computeSimilarity (const SymTensor3D& rhs) const;
 		
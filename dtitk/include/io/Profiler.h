@@ -0,0 +1,265 @@
+/*============================================================================
+
+  Program:     DTI ToolKit (DTI-TK)
+  Module:      $RCSfile: Profiler.h,v $
+  Language:    C++
+  Date:        $Date: 2026/10/18 17:05:12 $
+  Version:     $Revision: 1.1 $
+
+  Copyright (c) Gary Hui Zhang (garyhuizhang@gmail.com).
+  All rights reserverd.
+
+  DTI-TK is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  DTI-TK is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with DTI-TK.  If not, see <http://www.gnu.org/licenses/>.
+============================================================================*/
+
+
+// class Profiler and class ScopedTimer
+//
+// declaration and implementation
+//
+// a registry of named timers and counters: for every name, the number
+// of calls, the wall time, the CPU time, the voxels processed and the
+// bytes read or written.  the hot routines time themselves with a
+// ScopedTimer, which reports to the registry when it goes out of scope;
+// its wall time is what the "Done in" messages print, since clock()
+// sums the CPU time of all the threads.
+//
+// the registry is written as JSON when the environment variable
+// DTITK_PROFILE names a file, at exit and on SIGUSR1.  a %p in the name
+// is replaced by the process id, so concurrent runs of the population
+// scripts do not overwrite each other.  the signal only raises a flag;
+// the file is written when the next timer completes.
+
+#ifndef _io_Profiler_H
+#define _io_Profiler_H
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <map>
+#include <ctime>
+#include <cstdlib>
+#include <csignal>
+#include <sys/time.h>
+#include <unistd.h>
+
+namespace io {
+	
+	using namespace std;
+	
+	class Profiler {
+		public:
+		struct Entry {
+			unsigned long calls;
+			double wall;
+			double cpu;
+			unsigned long long voxels;
+			unsigned long long bytes;
+			
+			Entry () : calls(0), wall(0.0), cpu(0.0), voxels(0), bytes(0) {}
+		};
+		
+		protected:
+		map<string, Entry> entries;
+		
+		// where the registry is written, empty if not requested
+		string filename;
+		
+		static volatile sig_atomic_t& dumpRequested () {
+			static volatile sig_atomic_t flag = 0;
+			return flag;
+		}
+		
+		static void onSignal (int) {
+			dumpRequested() = 1;
+		}
+		
+		static void onExit () {
+			getInstance().dump();
+		}
+		
+		Profiler () {
+			const char *env = getenv("DTITK_PROFILE");
+			if (env == NULL || env[0] == '\0') {
+				return;
+			}
+			filename = env;
+			const size_t pid = filename.find("%p");
+			if (pid != string::npos) {
+				ostringstream oss;
+				oss << getpid();
+				filename.replace(pid, 2, oss.str());
+			}
+			atexit(onExit);
+			signal(SIGUSR1, onSignal);
+		}
+		
+		Profiler (const Profiler&);
+		Profiler& operator= (const Profiler&);
+		
+		static void writeString (ostream& out, const string& in) {
+			out << '"';
+			for (size_t i = 0; i < in.size(); ++i) {
+				if (in[i] == '"' || in[i] == '\\') {
+					out << '\\';
+				}
+				out << in[i];
+			}
+			out << '"';
+		}
+		
+		public:
+		// never destroyed, so that it outlives the atexit handler
+		static Profiler& getInstance () {
+			static Profiler *instance = new Profiler;
+			return *instance;
+		}
+		
+		// the wall time in seconds since the epoch
+		static double getWallTime () {
+			struct timeval tv;
+			gettimeofday(&tv, NULL);
+			return tv.tv_sec + tv.tv_usec * 1e-6;
+		}
+		
+		// the CPU time of the process in seconds
+		static double getCPUTime () {
+			return clock()/(double)CLOCKS_PER_SEC;
+		}
+		
+		void add (const string& name, const double wall, const double cpu,
+			const unsigned long long voxels = 0, const unsigned long long bytes = 0) {
+#ifdef _OPENMP
+			#pragma omp critical (io_Profiler)
+#endif
+			{
+				Entry& e = entries[name];
+				++e.calls;
+				e.wall += wall;
+				e.cpu += cpu;
+				e.voxels += voxels;
+				e.bytes += bytes;
+			}
+			if (dumpRequested()) {
+				dumpRequested() = 0;
+				dump();
+			}
+		}
+		
+		// a copy of the entry, with no calls if the name is unknown
+		Entry getEntry (const string& name) const {
+			Entry e;
+#ifdef _OPENMP
+			#pragma omp critical (io_Profiler)
+#endif
+			{
+				map<string, Entry>::const_iterator it = entries.find(name);
+				if (it != entries.end()) {
+					e = it->second;
+				}
+			}
+			return e;
+		}
+		
+		void clear () {
+#ifdef _OPENMP
+			#pragma omp critical (io_Profiler)
+#endif
+			entries.clear();
+		}
+		
+		void writeJSON (ostream& out) const {
+			map<string, Entry> copy;
+#ifdef _OPENMP
+			#pragma omp critical (io_Profiler)
+#endif
+			copy = entries;
+			out << "{" << endl;
+			out << "  \"pid\": " << getpid() << "," << endl;
+			out << "  \"timers\": {";
+			for (map<string, Entry>::const_iterator it = copy.begin(); it != copy.end(); ++it) {
+				const Entry& e = it->second;
+				out << (it == copy.begin() ? "" : ",") << endl << "    ";
+				writeString(out, it->first);
+				out << ": {\"calls\": " << e.calls;
+				out << setprecision(6) << fixed;
+				out << ", \"wall\": " << e.wall;
+				out << ", \"cpu\": " << e.cpu;
+				out.unsetf(ios::floatfield);
+				out << ", \"voxels\": " << e.voxels;
+				out << ", \"bytes\": " << e.bytes << "}";
+			}
+			out << endl << "  }" << endl << "}" << endl;
+		}
+		
+		bool writeJSON (const char *name) const {
+			ofstream out(name);
+			if (!out) {
+				cerr << "Fail to write the profile to " << name << endl;
+				return false;
+			}
+			writeJSON(out);
+			return true;
+		}
+		
+		// write to the file given by DTITK_PROFILE, if any
+		void dump () const {
+			if (filename.size() > 0) {
+				writeJSON(filename.c_str());
+			}
+		}
+	};
+	
+	class ScopedTimer {
+		protected:
+		string name;
+		double wall;
+		double cpu;
+		unsigned long long voxels;
+		unsigned long long bytes;
+		
+		ScopedTimer (const ScopedTimer&);
+		ScopedTimer& operator= (const ScopedTimer&);
+		
+		public:
+		ScopedTimer (const char *name) : name(name), voxels(0), bytes(0) {
+			// construct the registry before the clock starts
+			Profiler::getInstance();
+			wall = Profiler::getWallTime();
+			cpu = Profiler::getCPUTime();
+		}
+		
+		~ScopedTimer () {
+			Profiler::getInstance().add(name, elapsed(), Profiler::getCPUTime() - cpu, voxels, bytes);
+		}
+		
+		// the wall time since the construction
+		double elapsed () const {
+			return Profiler::getWallTime() - wall;
+		}
+		
+		void addVoxels (const unsigned long long n) {
+			voxels += n;
+		}
+		
+		void addBytes (const unsigned long long n) {
+			bytes += n;
+		}
+	};
+
+}
+
+#endif
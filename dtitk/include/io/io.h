@@ -32,6 +32,7 @@
 #include "dblOption.h"
 #include "intOption.h"
 #include "util.h"
+#include "Profiler.h"
 #include "Endian.h"
 #include "VTK.h"
 #include "VTKReader.h"
@@ -27,6 +27,8 @@
 #ifndef _numerics_Function_H
 #define _numerics_Function_H
 
+#include "OptimizerTrace.h"
+
 namespace numerics {
 	
 	class Function {
@@ -61,8 +63,11 @@ namespace numerics {
 		// input scaling factors
 		void setScaling (const double s[]);
 		
+		// the full parameter vector, as evaluated by the minimizers
 		inline double compute (const double p[]){
-			return function(p);
+			const double value = function(p);
+			OptimizerTrace::iterate(dim, p, &value, NULL);
+			return value;
 		}
 		
 		// line function value
@@ -0,0 +1,445 @@
+/*============================================================================
+
+  Program:     DTI ToolKit (DTI-TK)
+  Module:      $RCSfile: GLMTestStatistics.h,v $
+  Language:    C++
+  Date:        $Date: 2026/10/18 12:31:44 $
+  Version:     $Revision: 1.1 $
+
+  Copyright (c) Gary Hui Zhang (garyhuizhang@gmail.com).
+  All rights reserverd.
+
+  DTI-TK is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  DTI-TK is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with DTI-TK.  If not, see <http://www.gnu.org/licenses/>.
+============================================================================*/
+
+
+// general linear model t-statistics with Freedman-Lane permutation
+//
+// declaration and implementation
+//
+// the model is Y = X b + e with Y the observations x hypotheses data
+// matrix, X the observations x regressors design matrix, and a set of
+// t contrasts c, one of which is active at a time.
+//
+// Freedman-Lane permutes the residuals E = Rz Y of the reduced model,
+// whose design Z = X (I - c'c/cc') spans the nuisance part of X, and
+// adds back the reduced fit.  the fit lies in the column space of X,
+// so it changes neither c b nor the full model residuals: the
+// statistic of a permutation P is the statistic of P E.  with Q an
+// orthonormal basis of X and w = pinv(X)' c'
+//
+//   c b = (P'w)' E
+//   rss = |E|^2 - |(P'Q)' E|^2
+//   t   = c b / sqrt(rss / (n - rank(X)) * |w|^2)
+//
+// so one permutation needs the rank(X) + 1 rows of A' E, with
+// A = P'[Q w].  a batch of permutations stacks their A's and becomes
+// a single matrix product, computed blockwise over the hypotheses.
+//
+// the data are set by the subclass through setData.
+
+#ifndef _numerics_GLMTestStatistics_h
+#define _numerics_GLMTestStatistics_h
+
+#include "TestStatistics.h"
+#include <vector>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <cmath>
+#include <cstdlib>
+
+namespace numerics {
+	
+	using namespace std;
+	
+	class GLMTestStatistics : public TestStatistics {
+		protected:
+		// observations x regressors, row-major
+		vector< vector<double> > design;
+		// contrasts x regressors
+		vector< vector<double> > contrasts;
+		int activeContrast;
+		
+		// the data: observations x hypotheses, row s at data[s * stride]
+		int stride;
+		vector<double> data;
+		
+		// for the active contrast:
+		// residuals of the reduced model, laid out as data
+		vector<double> residuals;
+		// squared norm of the residuals at each hypothesis
+		vector<double> residualsSq;
+		// orthonormal basis of the design, observations x rank
+		vector< vector<double> > basis;
+		// the contrast weights pinv(X)' c'
+		vector<double> weights;
+		double weightsSq;
+		int dof;
+		
+		// hypotheses per block of the matrix product
+		static const int BlockSize = 256;
+		
+		// orthonormal basis of the columns of m (rows x cols) by
+		// modified Gram-Schmidt, dropping dependent columns
+		static void orthonormalize (const vector< vector<double> >& m, vector< vector<double> >& q) {
+			const int rows = m.size();
+			const int cols = rows > 0 ? m[0].size() : 0;
+			vector< vector<double> > v(cols, vector<double>(rows));
+			for (int i = 0; i < rows; ++i) {
+				for (int j = 0; j < cols; ++j) {
+					v[j][i] = m[i][j];
+				}
+			}
+			q.clear();
+			const double tol = 1.0e-10;
+			for (int j = 0; j < cols; ++j) {
+				double norm0 = 0.0;
+				for (int i = 0; i < rows; ++i) {
+					norm0 += v[j][i] * v[j][i];
+				}
+				for (size_t k = 0; k < q.size(); ++k) {
+					double d = 0.0;
+					for (int i = 0; i < rows; ++i) {
+						d += q[k][i] * v[j][i];
+					}
+					for (int i = 0; i < rows; ++i) {
+						v[j][i] -= d * q[k][i];
+					}
+				}
+				double norm = 0.0;
+				for (int i = 0; i < rows; ++i) {
+					norm += v[j][i] * v[j][i];
+				}
+				if (norm <= tol * tol * (norm0 + tol)) {
+					continue;
+				}
+				norm = std::sqrt(norm);
+				for (int i = 0; i < rows; ++i) {
+					v[j][i] /= norm;
+				}
+				q.push_back(v[j]);
+			}
+		}
+		
+		// read a whitespace separated matrix, skipping the header
+		// lines of FSL VEST files (/NumWaves, /Matrix, ...)
+		static void readMatrix (const char *filename, vector< vector<double> >& m) {
+			ifstream in(filename);
+			if (!in) {
+				cerr << "Fail to read the matrix " << filename << endl;
+				exit(1);
+			}
+			m.clear();
+			string line;
+			while (getline(in, line)) {
+				if (line.size() == 0 || line[0] == '/' || line[0] == '#') {
+					continue;
+				}
+				istringstream iss(line);
+				vector<double> row;
+				double value;
+				while (iss >> value) {
+					row.push_back(value);
+				}
+				if (row.size() == 0) {
+					continue;
+				}
+				if (m.size() > 0 && row.size() != m[0].size()) {
+					cerr << "Inconsistent number of columns in " << filename << endl;
+					exit(1);
+				}
+				m.push_back(row);
+			}
+		}
+		
+		// set up the active contrast
+		void prepareContrast () {
+			const int N = noOfObservations;
+			const int p = design[0].size();
+			const vector<double>& c = contrasts[activeContrast];
+			
+			// the full model
+			orthonormalize(design, basis);
+			const int rank = basis.size();
+			dof = N - rank;
+			if (dof <= 0) {
+				cerr << "The design has no residual degrees of freedom" << endl;
+				exit(1);
+			}
+			
+			// w = pinv(X)' c' = Q pinv(R)' c' with X = Q R
+			// R has full row rank, so pinv(R)' c' = (R R')^-1 R c'
+			vector< vector<double> > r(rank, vector<double>(p, 0.0));
+			for (int k = 0; k < rank; ++k) {
+				for (int j = 0; j < p; ++j) {
+					for (int i = 0; i < N; ++i) {
+						r[k][j] += basis[k][i] * design[i][j];
+					}
+				}
+			}
+			vector< vector<double> > g(rank, vector<double>(rank, 0.0));
+			vector<double> rc(rank, 0.0);
+			for (int k = 0; k < rank; ++k) {
+				for (int l = 0; l < rank; ++l) {
+					for (int j = 0; j < p; ++j) {
+						g[k][l] += r[k][j] * r[l][j];
+					}
+				}
+				for (int j = 0; j < p; ++j) {
+					rc[k] += r[k][j] * c[j];
+				}
+			}
+			vector<double> u;
+			solve(g, rc, u);
+			weights.assign(N, 0.0);
+			weightsSq = 0.0;
+			for (int i = 0; i < N; ++i) {
+				for (int k = 0; k < rank; ++k) {
+					weights[i] += basis[k][i] * u[k];
+				}
+				weightsSq += weights[i] * weights[i];
+			}
+			
+			// the reduced model Z = X (I - c'c/cc')
+			double cc = 0.0;
+			for (int j = 0; j < p; ++j) {
+				cc += c[j] * c[j];
+			}
+			if (cc == 0.0) {
+				cerr << "Contrast " << activeContrast + 1 << " is zero" << endl;
+				exit(1);
+			}
+			vector< vector<double> > z(N, vector<double>(p, 0.0));
+			for (int i = 0; i < N; ++i) {
+				double xc = 0.0;
+				for (int j = 0; j < p; ++j) {
+					xc += design[i][j] * c[j];
+				}
+				for (int j = 0; j < p; ++j) {
+					z[i][j] = design[i][j] - xc * c[j] / cc;
+				}
+			}
+			vector< vector<double> > qz;
+			orthonormalize(z, qz);
+			
+			// E = Y - Qz Qz' Y
+			residuals = data;
+			residualsSq.assign(stride, 0.0);
+			vector<double> proj(stride);
+			for (size_t k = 0; k < qz.size(); ++k) {
+				proj.assign(stride, 0.0);
+				for (int s = 0; s < N; ++s) {
+					const double a = qz[k][s];
+					const double *row = &data[(size_t)s * stride];
+					for (int h = 0; h < stride; ++h) {
+						proj[h] += a * row[h];
+					}
+				}
+				for (int s = 0; s < N; ++s) {
+					const double a = qz[k][s];
+					double *row = &residuals[(size_t)s * stride];
+					for (int h = 0; h < stride; ++h) {
+						row[h] -= a * proj[h];
+					}
+				}
+			}
+			for (int s = 0; s < N; ++s) {
+				const double *row = &residuals[(size_t)s * stride];
+				for (int h = 0; h < stride; ++h) {
+					residualsSq[h] += row[h] * row[h];
+				}
+			}
+		}
+		
+		// small dense solve by Gauss-Jordan elimination with partial
+		// pivoting; singular directions are left at zero
+		static void solve (vector< vector<double> > a, vector<double> b, vector<double>& x) {
+			const int n = b.size();
+			vector<int> pivotOf(n, -1);
+			for (int col = 0, row = 0; col < n && row < n; ++col) {
+				int best = row;
+				for (int i = row + 1; i < n; ++i) {
+					if (std::fabs(a[i][col]) > std::fabs(a[best][col])) {
+						best = i;
+					}
+				}
+				if (std::fabs(a[best][col]) < 1.0e-12) {
+					continue;
+				}
+				a[row].swap(a[best]);
+				const double tmp = b[row];
+				b[row] = b[best];
+				b[best] = tmp;
+				for (int i = 0; i < n; ++i) {
+					if (i == row) {
+						continue;
+					}
+					const double f = a[i][col] / a[row][col];
+					for (int j = col; j < n; ++j) {
+						a[i][j] -= f * a[row][j];
+					}
+					b[i] -= f * b[row];
+				}
+				pivotOf[col] = row;
+				++row;
+			}
+			x.assign(n, 0.0);
+			for (int col = 0; col < n; ++col) {
+				if (pivotOf[col] >= 0) {
+					x[col] = b[pivotOf[col]] / a[pivotOf[col]][col];
+				}
+			}
+		}
+		
+		// the statistics of a batch of permutations
+		// M = A' E over a block [h0, h1) of the hypotheses
+		void computeBlock (const vector< vector<int> >& perms, vector< vector<double> >& testStats, const int h0, const int h1) const {
+			const int N = noOfObservations;
+			const int rank = basis.size();
+			const int rows = rank + 1;
+			const int B = perms.size();
+			const int width = h1 - h0;
+			
+			// A: observations x (B * rows), the permuted basis and weights
+			vector<double> a((size_t)N * B * rows);
+			for (int b = 0; b < B; ++b) {
+				const vector<int>& perm = perms[b];
+				for (int s = 0; s < N; ++s) {
+					// row perm[s] of E is paired with entry s of the
+					// basis and weights, i.e. (P E)[s] = E[perm[s]]
+					double *as = &a[((size_t)perm[s] * B + b) * rows];
+					for (int k = 0; k < rank; ++k) {
+						as[k] = basis[k][s];
+					}
+					as[rank] = weights[s];
+				}
+			}
+			
+			vector<double> m((size_t)B * rows * width, 0.0);
+			for (int s = 0; s < N; ++s) {
+				const double *e = &residuals[(size_t)s * stride + h0];
+				const double *as = &a[(size_t)s * B * rows];
+				for (int r = 0; r < B * rows; ++r) {
+					const double coeff = as[r];
+					double *mr = &m[(size_t)r * width];
+					for (int h = 0; h < width; ++h) {
+						mr[h] += coeff * e[h];
+					}
+				}
+			}
+			
+			const double scale = 1.0 / dof * weightsSq;
+			for (int b = 0; b < B; ++b) {
+				double *t = &testStats[b][h0];
+				const double *cb = &m[((size_t)b * rows + rank) * width];
+				const double *ee = &residualsSq[h0];
+				vector<double> ss(width, 0.0);
+				for (int k = 0; k < rank; ++k) {
+					const double *mk = &m[((size_t)b * rows + k) * width];
+					for (int h = 0; h < width; ++h) {
+						ss[h] += mk[h] * mk[h];
+					}
+				}
+				for (int h = 0; h < width; ++h) {
+					const double rss = ee[h] - ss[h];
+					const double se = rss * scale;
+					t[h] = se > 0.0 ? cb[h] / std::sqrt(se) : 0.0;
+				}
+			}
+		}
+		
+		GLMTestStatistics (const char *designFile, const char *contrastFile) {
+			readMatrix(designFile, design);
+			readMatrix(contrastFile, contrasts);
+			if (design.size() == 0 || contrasts.size() == 0) {
+				cerr << "Empty design or contrast matrix" << endl;
+				exit(1);
+			}
+			if (contrasts[0].size() != design[0].size()) {
+				cerr << "The contrasts have " << contrasts[0].size();
+				cerr << " columns but the design has " << design[0].size() << endl;
+				exit(1);
+			}
+			noOfObservations = design.size();
+			// Freedman-Lane permutes all the observations
+			noOfGroup1Observations = noOfObservations;
+			noOfHypotheses = 0;
+			activeContrast = 0;
+			stride = 0;
+		}
+		
+		// data: observations x hypotheses, row-major
+		void setData (const vector<double>& in, const int hypotheses) {
+			if ((int)in.size() != noOfObservations * hypotheses) {
+				cerr << "The data do not match the design: " << in.size();
+				cerr << " values for " << noOfObservations << " observations" << endl;
+				exit(1);
+			}
+			noOfHypotheses = hypotheses;
+			stride = (hypotheses + 3) / 4 * 4;
+			data.assign((size_t)noOfObservations * stride, 0.0);
+			for (int s = 0; s < noOfObservations; ++s) {
+				for (int h = 0; h < hypotheses; ++h) {
+					data[(size_t)s * stride + h] = in[(size_t)s * hypotheses + h];
+				}
+			}
+			prepareContrast();
+		}
+		
+		public:
+		virtual ~GLMTestStatistics () {};
+		
+		int getNoOfContrasts () const {
+			return contrasts.size();
+		}
+		
+		// select the contrast the statistics are computed for
+		void setContrast (const int index) {
+			if (index < 0 || index >= (int)contrasts.size()) {
+				cerr << "Invalid contrast index " << index << endl;
+				exit(1);
+			}
+			activeContrast = index;
+			if (stride > 0) {
+				prepareContrast();
+			}
+		}
+		
+		bool isThreadSafe () const {
+			return true;
+		}
+		
+		void compute (const vector<int>& permutation, vector<double>& testStats) {
+			vector< vector<int> > perms(1, permutation);
+			vector< vector<double> > stats;
+			computeBatch(perms, stats);
+			testStats.swap(stats[0]);
+		}
+		
+		void computeBatch (const vector< vector<int> >& permutations, vector< vector<double> >& testStats) {
+			testStats.resize(permutations.size());
+			for (size_t b = 0; b < permutations.size(); ++b) {
+				testStats[b].resize(noOfHypotheses);
+			}
+			for (int h0 = 0; h0 < noOfHypotheses; h0 += BlockSize) {
+				const int h1 = h0 + BlockSize < noOfHypotheses ? h0 + BlockSize : noOfHypotheses;
+				computeBlock(permutations, testStats, h0, h1);
+			}
+		}
+	};
+}
+
+#endif
@@ -51,10 +51,13 @@ namespace numerics {
 		
 		inline void computeGradient (const double p[], double xi[]) {
 			gradient(p, xi);
+			OptimizerTrace::iterate(dim, p, NULL, xi);
 		}
 		
 		inline double computeFuncAndGrad (const double p[], double xi[]) {
-			return funcAndGrad(p, xi);
+			const double value = funcAndGrad(p, xi);
+			OptimizerTrace::iterate(dim, p, &value, xi);
+			return value;
 		}
 		
 		// line/directional gradient
@@ -0,0 +1,455 @@
+/*============================================================================
+
+  Program:     DTI ToolKit (DTI-TK)
+  Module:      $RCSfile: OptimizerTrace.h,v $
+  Language:    C++
+  Date:        $Date: 2026/10/18 17:48:30 $
+  Version:     $Revision: 1.1 $
+
+  Copyright (c) Gary Hui Zhang (garyhuizhang@gmail.com).
+  All rights reserverd.
+
+  DTI-TK is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  DTI-TK is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with DTI-TK.  If not, see <http://www.gnu.org/licenses/>.
+============================================================================*/
+
+
+// class OptimizerTrace
+//
+// declaration and implementation
+//
+// a structured record of the minimizations, in place of the Debug
+// printing.  the cost function and its gradient are handed to Function
+// and Gradient through the traced callbacks, which count every
+// evaluation, including those of the line searches in MinBracket,
+// Brent and LineMinimizer.  every evaluation of the full parameter
+// vector through Function::compute, Gradient::computeGradient and
+// Gradient::computeFuncAndGrad at a new point adds a row: the cost, the
+// gradient norm, the step from the previous row in the parameter space,
+// the evaluation counts and the wall time since the beginning of the
+// section.  the evaluations at the point of the previous row, e.g.
+// compute followed by computeGradient, fill in that row instead.
+// whether that makes one row per outer iteration depends on the
+// minimizers, which are not part of these headers: an extrapolated
+// point evaluated through compute, as in the direction set method, adds
+// a row of its own.
+//
+// a section is one minimization, e.g. one level of a registration:
+//
+//   OptimizerTrace trace;
+//   trace.setCallbacks(func, grad, funcAndGrad);
+//   Gradient g(n, OptimizerTrace::tracedFunction,
+//     OptimizerTrace::tracedGradient, OptimizerTrace::tracedFuncAndGrad);
+//   trace.begin("sep 4");
+//   minimizer.run(params, ftol, g);
+//   trace.end();
+//   trace.writeCSV("trace.csv");
+//
+// the callbacks are plain functions, so the trace being recorded is a
+// static; only one minimization can be traced at a time.
+//
+// a tool that does not record a trace itself gets one with the
+// environment variable DTITK_OPTIMIZER_TRACE set to a file name: all its
+// minimizations are recorded in one section, written when it exits, as
+// JSON if the name ends with .json and as CSV otherwise.  %p in the name
+// is replaced by the process id, which is otherwise inserted before the
+// extension, so that concurrent tools write files of their own:
+//
+//   DTITK_OPTIMIZER_TRACE=/tmp/trace.csv  ->  /tmp/trace.12345.csv
+//
+// its callbacks are not traced, so the evaluations are counted at the
+// entry points above instead; those of the line functions
+// (Function::funcOneDim and the like, implemented outside these
+// headers) are not counted.
+
+#ifndef _numerics_OptimizerTrace_H
+#define _numerics_OptimizerTrace_H
+
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+#include <sstream>
+#include <sys/time.h>
+#include <unistd.h>
+
+namespace numerics {
+	
+	using namespace std;
+	
+	class OptimizerTrace {
+		public:
+		struct Row {
+			string label;
+			int iteration;
+			bool hasValue;
+			double value;
+			bool hasGradient;
+			double gradientNorm;
+			double step;
+			long funcEvals;
+			long gradEvals;
+			double time;
+		};
+		
+		protected:
+		vector<Row> rows;
+		
+		// the section being recorded
+		string label;
+		int iteration;
+		long funcEvals;
+		long gradEvals;
+		double startTime;
+		
+		// the first row of the section
+		size_t first;
+		
+		// the parameters of the previous row
+		vector<double> last;
+		
+		// the callbacks being traced
+		double (*function) (const double[]);
+		void (*gradient) (const double[], double[]);
+		double (*funcAndGrad) (const double[], double[]);
+		
+		static OptimizerTrace *&current () {
+			static OptimizerTrace *trace = NULL;
+			return trace;
+		}
+		
+		static double getWallTime () {
+			struct timeval tv;
+			gettimeofday(&tv, NULL);
+			return tv.tv_sec + tv.tv_usec * 1e-6;
+		}
+		
+		static OptimizerTrace& getCurrent () {
+			if (current() == NULL) {
+				cerr << "OptimizerTrace: the callbacks are used outside of a section" << endl;
+				exit(1);
+			}
+			return *current();
+		}
+		
+		// the trace of DTITK_OPTIMIZER_TRACE and its file
+		static OptimizerTrace *&environment () {
+			static OptimizerTrace *trace = NULL;
+			return trace;
+		}
+		
+		static string& environmentFile () {
+			static string filename;
+			return filename;
+		}
+		
+		static void writeEnvironment () {
+			OptimizerTrace *trace = environment();
+			if (trace == NULL) {
+				return;
+			}
+			const string& filename = environmentFile();
+			if (filename.size() >= 5 && filename.compare(filename.size() - 5, 5, ".json") == 0) {
+				trace->writeJSON(filename.c_str());
+			} else {
+				trace->writeCSV(filename.c_str());
+			}
+		}
+		
+		// install the trace of DTITK_OPTIMIZER_TRACE, once, if set
+		static bool installFromEnvironment () {
+			static bool checked = false;
+			if (checked) {
+				return false;
+			}
+			checked = true;
+			const char *filename = getenv("DTITK_OPTIMIZER_TRACE");
+			if (filename == NULL || *filename == '\0') {
+				return false;
+			}
+			environmentFile() = expandProcessId(filename);
+			environment() = new OptimizerTrace;
+			environment()->begin("all");
+			atexit(writeEnvironment);
+			return true;
+		}
+		
+		// %p replaced by the process id, inserted before the extension
+		// if there is none
+		static string expandProcessId (const string& filename) {
+			ostringstream pid;
+			pid << getpid();
+			string out = filename;
+			size_t pos = out.find("%p");
+			if (pos != string::npos) {
+				do {
+					out.replace(pos, 2, pid.str());
+					pos = out.find("%p", pos + pid.str().size());
+				} while (pos != string::npos);
+				return out;
+			}
+			const size_t slash = out.rfind('/');
+			const size_t base = slash == string::npos ? 0 : slash + 1;
+			const size_t dot = out.find('.', base + 1);
+			if (dot == string::npos) {
+				return out + "." + pid.str();
+			}
+			return out.substr(0, dot) + "." + pid.str() + out.substr(dot);
+		}
+		
+		static void quoteCSV (ostream& out, const string& field) {
+			if (field.find_first_of(",\"\r\n") == string::npos) {
+				out << field;
+				return;
+			}
+			out << '"';
+			for (size_t i = 0; i < field.size(); ++i) {
+				if (field[i] == '"') {
+					out << '"';
+				}
+				out << field[i];
+			}
+			out << '"';
+		}
+		
+		static void quoteJSON (ostream& out, const string& field) {
+			out << '"';
+			for (size_t i = 0; i < field.size(); ++i) {
+				const char c = field[i];
+				if (c == '"' || c == '\\') {
+					out << '\\' << c;
+				} else if (c == '\n') {
+					out << "\\n";
+				} else if (c == '\t') {
+					out << "\\t";
+				} else if ((unsigned char)c < 0x20) {
+					out << "\\u" << hex << setw(4) << setfill('0') << (int)c << dec << setfill(' ');
+				} else {
+					out << c;
+				}
+			}
+			out << '"';
+		}
+		
+		OptimizerTrace (const OptimizerTrace&);
+		OptimizerTrace& operator= (const OptimizerTrace&);
+		
+		public:
+		OptimizerTrace () {
+			iteration = 0;
+			first = 0;
+			funcEvals = 0;
+			gradEvals = 0;
+			startTime = 0.0;
+			function = NULL;
+			gradient = NULL;
+			funcAndGrad = NULL;
+		}
+		
+		~OptimizerTrace () {
+			if (current() == this) {
+				current() = NULL;
+			}
+		}
+		
+		void setCallbacks (double (*func) (const double[]),
+			void (*grad) (const double[], double[]) = NULL,
+			double (*fag) (const double[], double[]) = NULL) {
+			function = func;
+			gradient = grad;
+			funcAndGrad = fag;
+		}
+		
+		// start recording a minimization under the given label
+		void begin (const string& in) {
+			label = in;
+			iteration = 0;
+			funcEvals = 0;
+			gradEvals = 0;
+			first = rows.size();
+			last.clear();
+			startTime = getWallTime();
+			current() = this;
+		}
+		
+		void end () {
+			if (current() == this) {
+				current() = NULL;
+			}
+		}
+		
+		const vector<Row>& getRows () const {
+			return rows;
+		}
+		
+		// the callbacks to hand to Function and Gradient
+		static double tracedFunction (const double p[]) {
+			OptimizerTrace& trace = getCurrent();
+			++trace.funcEvals;
+			return trace.function(p);
+		}
+		
+		static void tracedGradient (const double p[], double df[]) {
+			OptimizerTrace& trace = getCurrent();
+			++trace.gradEvals;
+			trace.gradient(p, df);
+		}
+		
+		static double tracedFuncAndGrad (const double p[], double df[]) {
+			OptimizerTrace& trace = getCurrent();
+			++trace.funcEvals;
+			++trace.gradEvals;
+			return trace.funcAndGrad(p, df);
+		}
+		
+		// an evaluation of the full parameter vector by a minimizer
+		// value and df are NULL if not evaluated
+		static void iterate (const int dim, const double p[], const double *value, const double *df) {
+			if (current() == NULL && !installFromEnvironment()) {
+				return;
+			}
+			OptimizerTrace& trace = *current();
+			
+			// without traced callbacks, the evaluations are counted here
+			if (trace.function == NULL) {
+				if (value != NULL) {
+					++trace.funcEvals;
+				}
+				if (df != NULL) {
+					++trace.gradEvals;
+				}
+			}
+			
+			// at the point of the previous row
+			if (trace.rows.size() > trace.first && trace.last.size() == (size_t)dim
+				&& equal(trace.last.begin(), trace.last.end(), p)) {
+				Row& row = trace.rows.back();
+				if (value != NULL) {
+					row.hasValue = true;
+					row.value = *value;
+				}
+				if (df != NULL) {
+					row.hasGradient = true;
+					row.gradientNorm = 0.0;
+					for (int i = 0; i < dim; ++i) {
+						row.gradientNorm += df[i] * df[i];
+					}
+					row.gradientNorm = sqrt(row.gradientNorm);
+				}
+				row.funcEvals = trace.funcEvals;
+				row.gradEvals = trace.gradEvals;
+				row.time = getWallTime() - trace.startTime;
+				return;
+			}
+			
+			Row row;
+			row.label = trace.label;
+			row.iteration = trace.iteration++;
+			row.hasValue = value != NULL;
+			row.value = value != NULL ? *value : 0.0;
+			row.hasGradient = df != NULL;
+			row.gradientNorm = 0.0;
+			row.step = 0.0;
+			for (int i = 0; i < dim; ++i) {
+				if (df != NULL) {
+					row.gradientNorm += df[i] * df[i];
+				}
+				if (trace.last.size() > 0) {
+					row.step += (p[i] - trace.last[i]) * (p[i] - trace.last[i]);
+				}
+			}
+			row.gradientNorm = sqrt(row.gradientNorm);
+			row.step = sqrt(row.step);
+			row.funcEvals = trace.funcEvals;
+			row.gradEvals = trace.gradEvals;
+			row.time = getWallTime() - trace.startTime;
+			trace.last.assign(p, p + dim);
+			trace.rows.push_back(row);
+		}
+		
+		void writeCSV (ostream& out) const {
+			out << "label,iteration,value,gradient_norm,step,function_evaluations,gradient_evaluations,time" << endl;
+			out << setprecision(10);
+			for (size_t r = 0; r < rows.size(); ++r) {
+				const Row& row = rows[r];
+				quoteCSV(out, row.label);
+				out << ',' << row.iteration << ',';
+				if (row.hasValue) {
+					out << row.value;
+				}
+				out << ',';
+				if (row.hasGradient) {
+					out << row.gradientNorm;
+				}
+				out << ',' << row.step << ',' << row.funcEvals << ',' << row.gradEvals;
+				out << ',' << row.time << endl;
+			}
+		}
+		
+		void writeJSON (ostream& out) const {
+			out << setprecision(10);
+			out << "[";
+			for (size_t r = 0; r < rows.size(); ++r) {
+				const Row& row = rows[r];
+				out << (r == 0 ? "" : ",") << endl;
+				out << "  {\"label\": ";
+				quoteJSON(out, row.label);
+				out << ", \"iteration\": " << row.iteration;
+				out << ", \"value\": ";
+				if (row.hasValue) {
+					out << row.value;
+				} else {
+					out << "null";
+				}
+				out << ", \"gradient_norm\": ";
+				if (row.hasGradient) {
+					out << row.gradientNorm;
+				} else {
+					out << "null";
+				}
+				out << ", \"step\": " << row.step;
+				out << ", \"function_evaluations\": " << row.funcEvals;
+				out << ", \"gradient_evaluations\": " << row.gradEvals;
+				out << ", \"time\": " << row.time << "}";
+			}
+			out << endl << "]" << endl;
+		}
+		
+		bool writeCSV (const char *filename) const {
+			ofstream out(filename);
+			if (!out) {
+				cerr << "Fail to write the optimizer trace to " << filename << endl;
+				return false;
+			}
+			writeCSV(out);
+			return true;
+		}
+		
+		bool writeJSON (const char *filename) const {
+			ofstream out(filename);
+			if (!out) {
+				cerr << "Fail to write the optimizer trace to " << filename << endl;
+				return false;
+			}
+			writeJSON(out);
+			return true;
+		}
+	};
+
+}
+
+#endif
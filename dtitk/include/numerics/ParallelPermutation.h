@@ -0,0 +1,302 @@
+/*============================================================================
+
+  Program:     DTI ToolKit (DTI-TK)
+  Module:      $RCSfile: ParallelPermutation.h,v $
+  Language:    C++
+  Date:        $Date: 2026/10/18 11:02:17 $
+  Version:     $Revision: 1.1 $
+
+  Copyright (c) Gary Hui Zhang (garyhuizhang@gmail.com).
+  All rights reserverd.
+
+  DTI-TK is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  DTI-TK is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with DTI-TK.  If not, see <http://www.gnu.org/licenses/>.
+============================================================================*/
+
+
+// multi-threaded permutation testing
+//
+// declaration and implementation
+//
+// the permutations are distributed over OpenMP threads.  each
+// permutation draws its relabeling from its own random stream seeded
+// by (seed, permutation number), so the results for a given seed are
+// identical whatever the number of threads.  the maximum statistic of
+// every permutation is stored by permutation number, and the exceedance
+// counts needed for the FDR are accumulated per thread and summed at
+// the end.
+//
+// the permutation passed to TestStatistics::compute lists all the
+// observations; the first noOfGroup1Observations entries form group 1.
+// permutation 0 is the identity, i.e. the observed labeling.
+//
+// larger statistics are more significant; for two-sided tests the
+// TestStatistics is expected to return magnitudes.
+
+#ifndef _numerics_ParallelPermutation_h
+#define _numerics_ParallelPermutation_h
+
+#include "Permutation.h"
+#include <vector>
+#include <algorithm>
+#include <iostream>
+#include <cstdlib>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace numerics {
+	
+	using namespace std;
+	
+	class ParallelPermutation : public Permutation {
+		protected:
+		unsigned long seed;
+		int noOfThreads;
+		int batchSize;
+		bool verbose;
+		
+		// the maximum statistic of every permutation
+		vector<double> maxStats;
+		
+		// the observed statistics
+		vector<double> observed;
+		
+		// counter-based random stream, one per permutation
+		// splitmix64 from Steele et al, OOPSLA 2014
+		class Stream {
+			unsigned long long state;
+			
+			public:
+			Stream (unsigned long seed, int permutation) {
+				state = (unsigned long long)seed * 0x9E3779B97F4A7C15ULL;
+				state ^= (unsigned long long)(permutation + 1) * 0xBF58476D1CE4E5B9ULL;
+			}
+			
+			unsigned long long next () {
+				unsigned long long z = (state += 0x9E3779B97F4A7C15ULL);
+				z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+				z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+				return z ^ (z >> 31);
+			}
+			
+			// uniform integer in [0, n)
+			int uniform (const int n) {
+				return (int)(next() % (unsigned long long)n);
+			}
+		};
+		
+		// the relabeling for the given permutation number
+		void buildPermutation (const int p, vector<int>& perm) const {
+			for (int i = 0; i < noOfObservations; ++i) {
+				perm[i] = i;
+			}
+			if (p == 0) {
+				return;
+			}
+			// only the group 1 membership matters: a partial
+			// Fisher-Yates shuffle of the first group is enough
+			Stream stream(seed, p);
+			for (int i = 0; i < noOfGroup1Observations; ++i) {
+				const int j = i + stream.uniform(noOfObservations - i);
+				const int tmp = perm[i];
+				perm[i] = perm[j];
+				perm[j] = tmp;
+			}
+		}
+		
+		int getNoOfThreads () const {
+			int n = noOfThreads;
+#ifdef _OPENMP
+			if (n <= 0) {
+				n = omp_get_max_threads();
+			}
+#else
+			n = 1;
+#endif
+			if (!ts->isThreadSafe()) {
+				n = 1;
+			}
+			return n;
+		}
+		
+		public:
+		ParallelPermutation (TestStatistics *in, int noOfPerms = 1000)
+			: Permutation(in, noOfPerms) {
+			seed = 1;
+			noOfThreads = 0;
+			batchSize = 1;
+			verbose = true;
+		}
+		
+		void setSeed (const unsigned long in) {
+			seed = in;
+		}
+		
+		// 0 means all the available threads
+		void setNoOfThreads (const int in) {
+			noOfThreads = in;
+		}
+		
+		// number of permutations handed to TestStatistics::computeBatch
+		// at once; the batches are what is distributed over the threads
+		void setBatchSize (const int in) {
+			batchSize = in < 1 ? 1 : in;
+		}
+		
+		void setVerbose (const bool in) {
+			verbose = in;
+		}
+		
+		void getMaxStatistics (vector<double>& out) const {
+			out = maxStats;
+		}
+		
+		void run () {
+			noOfObservations = ts->getNoOfObservations();
+			noOfGroup1Observations = ts->getNoOfGroup1Observations();
+			noOfHypotheses = ts->getNoOfHypotheses();
+			if (noOfHypotheses <= 0) {
+				cerr << "No hypotheses to test (empty mask?)" << endl;
+				exit(1);
+			}
+			
+			const int H = noOfHypotheses;
+			const int P = noOfPermutations;
+			const int threads = getNoOfThreads();
+			
+			// the observed statistics and their ascending order
+			inPermutation.resize(noOfObservations);
+			buildPermutation(0, inPermutation);
+			observed.resize(H);
+			ts->compute(inPermutation, observed);
+			vector<double> sortedObserved(observed);
+			sort(sortedObserved.begin(), sortedObserved.end());
+			
+			maxStats.assign(P, 0.0);
+			const int noOfBatches = (P + batchSize - 1) / batchSize;
+			
+			// exceedance[t][m]: number of permuted statistics, over all
+			// the permutations done by thread t, that are at least as
+			// large as sortedObserved[m]
+			vector< vector<double> > exceedance(threads, vector<double>(H, 0.0));
+			
+			if (verbose) {
+				cout << "Running " << P << " permutations on " << threads;
+				cout << (threads == 1 ? " thread" : " threads") << " ... " << flush;
+			}
+			int done = 0;
+			int reported = 0;
+
+#ifdef _OPENMP
+			#pragma omp parallel num_threads(threads)
+#endif
+			{
+				int t = 0;
+#ifdef _OPENMP
+				t = omp_get_thread_num();
+#endif
+				vector< vector<int> > perms;
+				vector< vector<double> > batchStats;
+				vector<double>& count = exceedance[t];
+				
+#ifdef _OPENMP
+				#pragma omp for schedule(dynamic, 1)
+#endif
+				for (int b = 0; b < noOfBatches; ++b) {
+					const int first = b * batchSize;
+					const int last = first + batchSize < P ? first + batchSize : P;
+					perms.resize(last - first);
+					for (int p = first; p < last; ++p) {
+						perms[p - first].resize(noOfObservations);
+						buildPermutation(p, perms[p - first]);
+					}
+					ts->computeBatch(perms, batchStats);
+					
+					for (int p = first; p < last; ++p) {
+						vector<double>& stats = batchStats[p - first];
+						// sorting once makes the exceedance counting a merge
+						sort(stats.begin(), stats.end());
+						maxStats[p] = stats[H - 1];
+						int s = H - 1;
+						for (int m = H - 1; m >= 0; --m) {
+							while (s >= 0 && stats[s] >= sortedObserved[m]) {
+								--s;
+							}
+							count[m] += H - 1 - s;
+						}
+					}
+					
+					if (verbose) {
+#ifdef _OPENMP
+						#pragma omp critical (permutation_progress)
+#endif
+						{
+							done += last - first;
+							if (done * 10 / P > reported) {
+								reported = done * 10 / P;
+								cout << reported * 10 << "% " << flush;
+							}
+						}
+					}
+				}
+			}
+			
+			if (verbose) {
+				cout << "Done" << endl;
+			}
+			
+			// merge the per-thread counters
+			vector<double> total(H, 0.0);
+			for (int t = 0; t < threads; ++t) {
+				for (int m = 0; m < H; ++m) {
+					total[m] += exceedance[t][m];
+				}
+			}
+			
+			// FWER: fraction of permutations whose maximum reaches the
+			// observed statistic
+			vector<double> sortedMax(maxStats);
+			sort(sortedMax.begin(), sortedMax.end());
+			adjustedFWER.resize(H);
+			for (int h = 0; h < H; ++h) {
+				const int below = lower_bound(sortedMax.begin(), sortedMax.end(), observed[h]) - sortedMax.begin();
+				adjustedFWER[h] = (double)(P - below) / P;
+			}
+			
+			// FDR: expected number of permuted exceedances over the
+			// observed number of exceedances, made monotone from the
+			// smallest statistic upwards
+			// with ties the first of the tied entries is the one used
+			vector<double> fdrSorted(H);
+			for (int m = 0; m < H; ++m) {
+				const double discoveries = H - m;
+				double fdr = total[m] / P / discoveries;
+				fdrSorted[m] = fdr > 1.0 ? 1.0 : fdr;
+			}
+			for (int m = 1; m < H; ++m) {
+				// a hypothesis is also rejected at every lower threshold
+				if (fdrSorted[m] > fdrSorted[m - 1]) {
+					fdrSorted[m] = fdrSorted[m - 1];
+				}
+			}
+			adjustedFDR.resize(H);
+			for (int h = 0; h < H; ++h) {
+				const int m = lower_bound(sortedObserved.begin(), sortedObserved.end(), observed[h]) - sortedObserved.begin();
+				adjustedFDR[h] = fdrSorted[m];
+			}
+		}
+	};
+}
+
+#endif
@@ -0,0 +1,297 @@
+/*============================================================================
+
+  Program:     DTI ToolKit (DTI-TK)
+  Module:      $RCSfile: TFCETestStatistics.h,v $
+  Language:    C++
+  Date:        $Date: 2026/10/18 13:45:52 $
+  Version:     $Revision: 1.1 $
+
+  Copyright (c) Gary Hui Zhang (garyhuizhang@gmail.com).
+  All rights reserverd.
+
+  DTI-TK is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  DTI-TK is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with DTI-TK.  If not, see <http://www.gnu.org/licenses/>.
+============================================================================*/
+
+
+// threshold-free cluster enhancement (Smith & Nichols, NeuroImage 2009)
+//
+// declaration and implementation
+//
+// wraps a voxelwise TestStatistics and replaces its statistics with
+//
+//   TFCE(v) = integral from 0 to t(v) of e(h)^E h^H dh
+//
+// where e(h) is the size of the cluster containing v at threshold h.
+// the integral is exact rather than stepped: the voxels are sorted once
+// per permutation and added from the highest statistic down into a
+// union-find forest.  a cluster is constant between two consecutive
+// voxel values, so each root only records the level at which its size
+// last changed; its contribution e^E (G(h0) - G(h)), G(h) = h^(H+1)/(H+1),
+// is flushed when it grows or merges.  the contribution is added to the
+// root and the voxels read their score as the sum along their path to
+// the root, which path compression preserves.
+//
+// the voxel graph is built once from the hypotheses indices with 6, 18
+// or 26 connectivity.  with twoSided, the negative statistics are
+// enhanced separately and the magnitudes returned, as expected by the
+// permutation engines.
+
+#ifndef _numerics_TFCETestStatistics_h
+#define _numerics_TFCETestStatistics_h
+
+#include "TestStatistics.h"
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <cstdlib>
+
+namespace numerics {
+	
+	using namespace std;
+	
+	class TFCETestStatistics : public TestStatistics {
+		protected:
+		TestStatistics *ts;
+		double extentExponent;
+		double heightExponent;
+		bool twoSided;
+		
+		// the voxel graph in compressed row form
+		vector<int> neighbourStart;
+		vector<int> neighbours;
+		
+		struct Level {
+			double stat;
+			int index;
+			bool operator< (const Level& rhs) const {
+				return stat > rhs.stat;
+			}
+		};
+		
+		// per call working storage
+		struct Forest {
+			vector<int> parent;
+			vector<int> size;
+			// score relative to the parent; absolute at a root
+			vector<double> score;
+			// the level at which the size of a root last changed
+			vector<double> since;
+			
+			void reset (const int n) {
+				parent.assign(n, -1);
+				size.assign(n, 0);
+				score.assign(n, 0.0);
+				since.assign(n, 0.0);
+			}
+			
+			// root of v, compressing the path while keeping
+			// the score sums along it
+			int find (const int v) {
+				int root = v;
+				double offset = 0.0;
+				while (parent[root] != root) {
+					offset += score[root];
+					root = parent[root];
+				}
+				// second pass: point every node straight at the root,
+				// its score becoming its offset from the root
+				int node = v;
+				while (node != root) {
+					const int next = parent[node];
+					const double own = score[node];
+					score[node] = offset;
+					parent[node] = root;
+					offset -= own;
+					node = next;
+				}
+				return root;
+			}
+		};
+		
+		double integral (const double h) const {
+			return std::pow(h, heightExponent + 1.0) / (heightExponent + 1.0);
+		}
+		
+		void flush (Forest& f, const int root, const double h) const {
+			f.score[root] += std::pow((double)f.size[root], extentExponent) * (integral(f.since[root]) - integral(h));
+			f.since[root] = h;
+		}
+		
+		// TFCE of the positive part of stats, added to out
+		void enhance (const vector<double>& stats, const double sign, vector<double>& out) const {
+			const int H = stats.size();
+			vector<Level> levels;
+			levels.reserve(H);
+			for (int h = 0; h < H; ++h) {
+				const double value = sign * stats[h];
+				if (value > 0.0) {
+					Level l;
+					l.stat = value;
+					l.index = h;
+					levels.push_back(l);
+				}
+			}
+			sort(levels.begin(), levels.end());
+			
+			Forest f;
+			f.reset(H);
+			for (size_t l = 0; l < levels.size(); ++l) {
+				const int v = levels[l].index;
+				const double h = levels[l].stat;
+				f.parent[v] = v;
+				f.size[v] = 1;
+				f.since[v] = h;
+				int root = v;
+				for (int n = neighbourStart[v]; n < neighbourStart[v + 1]; ++n) {
+					const int u = neighbours[n];
+					if (f.parent[u] < 0) {
+						continue;
+					}
+					const int other = f.find(u);
+					if (other == root) {
+						continue;
+					}
+					flush(f, other, h);
+					flush(f, root, h);
+					// union by size, the smaller root goes under
+					int big = root;
+					int small = other;
+					if (f.size[small] > f.size[big]) {
+						big = other;
+						small = root;
+					}
+					f.parent[small] = big;
+					f.score[small] -= f.score[big];
+					f.size[big] += f.size[small];
+					root = big;
+				}
+			}
+			
+			// close every cluster down to zero
+			for (size_t l = 0; l < levels.size(); ++l) {
+				const int v = levels[l].index;
+				if (f.parent[v] == v) {
+					flush(f, v, 0.0);
+				}
+			}
+			for (size_t l = 0; l < levels.size(); ++l) {
+				const int v = levels[l].index;
+				const int root = f.find(v);
+				double value = f.score[v];
+				if (v != root) {
+					value += f.score[root];
+				}
+				out[v] += sign * value;
+			}
+		}
+		
+		void transform (vector<double>& stats) const {
+			vector<double> out(stats.size(), 0.0);
+			enhance(stats, 1.0, out);
+			if (twoSided) {
+				enhance(stats, -1.0, out);
+				for (size_t h = 0; h < out.size(); ++h) {
+					out[h] = std::fabs(out[h]);
+				}
+			}
+			stats.swap(out);
+		}
+		
+		public:
+		// index: the voxel (i,j,k) of every hypothesis of ts
+		TFCETestStatistics (TestStatistics *in, const vector< vector<int> >& index, const int connectivity = 26,
+			const double E = 0.5, const double H = 2.0, const bool both = false)
+			: ts(in), extentExponent(E), heightExponent(H), twoSided(both) {
+			noOfObservations = ts->getNoOfObservations();
+			noOfGroup1Observations = ts->getNoOfGroup1Observations();
+			noOfHypotheses = ts->getNoOfHypotheses();
+			if ((int)index.size() != noOfHypotheses) {
+				cerr << "The voxel index does not match the number of hypotheses" << endl;
+				exit(1);
+			}
+			if (connectivity != 6 && connectivity != 18 && connectivity != 26) {
+				cerr << "Invalid connectivity " << connectivity << endl;
+				exit(1);
+			}
+			
+			// lookup grid over the bounding box of the hypotheses
+			int lo[3] = {0, 0, 0};
+			int hi[3] = {0, 0, 0};
+			for (int h = 0; h < noOfHypotheses; ++h) {
+				for (int m = 0; m < 3; ++m) {
+					if (h == 0 || index[h][m] < lo[m]) {
+						lo[m] = index[h][m];
+					}
+					if (h == 0 || index[h][m] > hi[m]) {
+						hi[m] = index[h][m];
+					}
+				}
+			}
+			const int dim[3] = {hi[0] - lo[0] + 1, hi[1] - lo[1] + 1, hi[2] - lo[2] + 1};
+			vector<int> grid(noOfHypotheses > 0 ? (size_t)dim[0] * dim[1] * dim[2] : 0, -1);
+			for (int h = 0; h < noOfHypotheses; ++h) {
+				const size_t g = ((size_t)(index[h][2] - lo[2]) * dim[1] + (index[h][1] - lo[1])) * dim[0] + (index[h][0] - lo[0]);
+				grid[g] = h;
+			}
+			
+			neighbourStart.assign(noOfHypotheses + 1, 0);
+			neighbours.clear();
+			for (int h = 0; h < noOfHypotheses; ++h) {
+				neighbourStart[h] = neighbours.size();
+				for (int dz = -1; dz <= 1; ++dz) {
+					for (int dy = -1; dy <= 1; ++dy) {
+						for (int dx = -1; dx <= 1; ++dx) {
+							const int manhattan = abs(dx) + abs(dy) + abs(dz);
+							if (manhattan == 0 || (connectivity == 6 && manhattan > 1) || (connectivity == 18 && manhattan > 2)) {
+								continue;
+							}
+							const int x = index[h][0] + dx - lo[0];
+							const int y = index[h][1] + dy - lo[1];
+							const int z = index[h][2] + dz - lo[2];
+							if (x < 0 || x >= dim[0] || y < 0 || y >= dim[1] || z < 0 || z >= dim[2]) {
+								continue;
+							}
+							const int u = grid[((size_t)z * dim[1] + y) * dim[0] + x];
+							if (u >= 0) {
+								neighbours.push_back(u);
+							}
+						}
+					}
+				}
+			}
+			neighbourStart[noOfHypotheses] = neighbours.size();
+		}
+		
+		~TFCETestStatistics () {};
+		
+		bool isThreadSafe () const {
+			return ts->isThreadSafe();
+		}
+		
+		void compute (const vector<int>& permutation, vector<double>& testStats) {
+			ts->compute(permutation, testStats);
+			transform(testStats);
+		}
+		
+		void computeBatch (const vector< vector<int> >& permutations, vector< vector<double> >& testStats) {
+			ts->computeBatch(permutations, testStats);
+			for (size_t b = 0; b < testStats.size(); ++b) {
+				transform(testStats[b]);
+			}
+		}
+	};
+}
+
+#endif
@@ -46,6 +46,23 @@ namespace numerics {
 		int getNoOfGroup1Observations () const;
 		int getNoOfHypotheses () const;
 		virtual void compute (const vector<int>& permutation, vector<double>& testStats) = 0;
+		
+		// whether compute can be called concurrently from several
+		// threads on the same object
+		// implementations that keep per-call scratch data as members
+		// must leave this false
+		virtual bool isThreadSafe () const {return false;}
+		
+		// several permutations at once
+		// statistics that can share work across permutations, e.g.
+		// by turning matrix-vector products into a matrix product,
+		// should override this
+		virtual void computeBatch (const vector< vector<int> >& permutations, vector< vector<double> >& testStats) {
+			testStats.resize(permutations.size());
+			for (size_t i = 0; i < permutations.size(); ++i) {
+				compute(permutations[i], testStats[i]);
+			}
+		}
 	};
 }
 
@@ -29,6 +29,7 @@
 
 #include "MathUtil.h"
 
+#include "OptimizerTrace.h"
 #include "Function.h"
 #include "Gradient.h"
 #include "MinBracket.h"
@@ -41,6 +42,8 @@
 #include "SymMatrix.h"
 
 #include "Permutation.h"
+#include "ParallelPermutation.h"
+#include "TFCETestStatistics.h"
 
 #endif
 
@@ -0,0 +1,275 @@
+/*============================================================================
+
+  Program:     DTI ToolKit (DTI-TK)
+  Module:      $RCSfile: CubicBSplineInterpolation.h,v $
+  Language:    C++
+  Date:        $Date: 2026/10/18 15:10:21 $
+  Version:     $Revision: 1.1 $
+
+  Copyright (c) Gary Hui Zhang (garyhuizhang@gmail.com).
+  All rights reserverd.
+
+  DTI-TK is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  DTI-TK is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with DTI-TK.  If not, see <http://www.gnu.org/licenses/>.
+============================================================================*/
+
+
+// cubic B-spline interpolation kernels
+//
+// declaration and implementation
+//
+// the interpolating cubic B-spline needs the coefficients that make
+// the spline pass through the voxel values.  they are computed once by
+// the recursive prefilter of Unser et al (IEEE TSP 1993), applied along
+// each axis with mirror boundary conditions.
+//
+// evaluation at a relative coordinate is separable: four weights per
+// axis from the fractional part, and the 4x4x4 neighbourhood of
+// coefficients, mirrored at the boundaries.  the derivatives use the
+// derivative weights along one axis and are returned in the absolute
+// scale, like Volume::buildGradient.
+//
+// as in TrilinearInterpolation.h, double, Vector3D and SymTensor3D work
+// on the components directly; other objects use their arithmetic.
+
+#ifndef _volume_CubicBSplineInterpolation_H
+#define _volume_CubicBSplineInterpolation_H
+
+#include "../geometry/Vector3D.h"
+#include "../geometry/SymTensor3D.h"
+#include <cmath>
+
+namespace volume {
+	
+	using namespace geometry;
+	
+	// the weights and mirrored indices along one axis
+	struct CubicBSplineAxis {
+		int index[4];
+		double weight[4];
+		double deriv[4];
+		
+		// x: the relative coordinate, n: the number of voxels
+		void set (const double x, const int n) {
+			const int base = (int)std::floor(x);
+			const double t = x - base;
+			const double s = 1.0 - t;
+			const double t2 = t * t;
+			const double t3 = t2 * t;
+			weight[0] = s * s * s / 6.0;
+			weight[1] = (4.0 - 6.0 * t2 + 3.0 * t3) / 6.0;
+			weight[2] = (1.0 + 3.0 * t + 3.0 * t2 - 3.0 * t3) / 6.0;
+			weight[3] = t3 / 6.0;
+			deriv[0] = -0.5 * s * s;
+			deriv[1] = 1.5 * t2 - 2.0 * t;
+			deriv[2] = 0.5 + t - 1.5 * t2;
+			deriv[3] = 0.5 * t2;
+			for (int m = 0; m < 4; ++m) {
+				index[m] = mirror(base - 1 + m, n);
+			}
+		}
+		
+		// mirror boundary without repeating the edge voxel
+		static int mirror (int i, const int n) {
+			if (n == 1) {
+				return 0;
+			}
+			const int period = 2 * n - 2;
+			i %= period;
+			if (i < 0) {
+				i += period;
+			}
+			return i < n ? i : period - i;
+		}
+	};
+	
+	// the pole of the cubic B-spline prefilter
+	inline double cubicBSplinePole () {
+		return std::sqrt(3.0) - 2.0;
+	}
+	
+	// the component kernel shared by the specializations
+	//
+	// grad may be NULL when the derivatives are not required
+	template <int N>
+	inline void cubicBSplineComponents (const double *const *const *coeff, const CubicBSplineAxis axis[3],
+		const double ivsize[3], double *out, double *grad[3]) {
+		double value[N];
+		double dx[N];
+		double dy[N];
+		double dz[N];
+		for (int m = 0; m < N; ++m) {
+			value[m] = dx[m] = dy[m] = dz[m] = 0.0;
+		}
+		for (int a = 0; a < 4; ++a) {
+			for (int b = 0; b < 4; ++b) {
+				const double *row = coeff[axis[0].index[a]][axis[1].index[b]];
+				// the sums along z for this row
+				double s[N];
+				double ds[N];
+				for (int m = 0; m < N; ++m) {
+					s[m] = ds[m] = 0.0;
+				}
+				for (int c = 0; c < 4; ++c) {
+					const double *p = row + (size_t)axis[2].index[c] * N;
+					const double w = axis[2].weight[c];
+					const double d = axis[2].deriv[c];
+					for (int m = 0; m < N; ++m) {
+						s[m] += w * p[m];
+						ds[m] += d * p[m];
+					}
+				}
+				const double wxy = axis[0].weight[a] * axis[1].weight[b];
+				const double dxy = axis[0].deriv[a] * axis[1].weight[b];
+				const double wdy = axis[0].weight[a] * axis[1].deriv[b];
+				for (int m = 0; m < N; ++m) {
+					value[m] += wxy * s[m];
+					dx[m] += dxy * s[m];
+					dy[m] += wdy * s[m];
+					dz[m] += wxy * ds[m];
+				}
+			}
+		}
+		for (int m = 0; m < N; ++m) {
+			out[m] = value[m];
+		}
+		if (grad != NULL) {
+			for (int m = 0; m < N; ++m) {
+				grad[0][m] = dx[m] * ivsize[0];
+				grad[1][m] = dy[m] * ivsize[1];
+				grad[2][m] = dz[m] * ivsize[2];
+			}
+		}
+	}
+	
+	template <class Object>
+	struct CubicBSplineInterpolation {
+		// in-place prefilter of one line of n coefficients
+		static void prefilterLine (Object *c, const int n) {
+			if (n < 2) {
+				return;
+			}
+			const double z = cubicBSplinePole();
+			const double lambda = (1.0 - z) * (1.0 - 1.0 / z);
+			for (int k = 0; k < n; ++k) {
+				c[k] *= lambda;
+			}
+			
+			// causal initialization
+			const int horizon = (int)std::ceil(std::log(1e-16) / std::log(std::fabs(z)));
+			Object sum(c[0]);
+			if (horizon < n) {
+				// truncated at machine precision
+				double zk = z;
+				for (int k = 1; k < horizon; ++k) {
+					sum += zk * c[k];
+					zk *= z;
+				}
+			} else {
+				// exact for the mirrored line
+				double zk = z;
+				double z2k = std::pow(z, n - 1);
+				sum += z2k * c[n - 1];
+				z2k *= z2k / z;
+				for (int k = 1; k < n - 1; ++k) {
+					sum += (zk + z2k) * c[k];
+					zk *= z;
+					z2k /= z;
+				}
+				sum *= 1.0 / (1.0 - zk * zk);
+			}
+			c[0] = sum;
+			for (int k = 1; k < n; ++k) {
+				c[k] += z * c[k - 1];
+			}
+			
+			// anti-causal initialization
+			Object last(c[n - 2]);
+			last *= z;
+			last += c[n - 1];
+			last *= z / (z * z - 1.0);
+			c[n - 1] = last;
+			for (int k = n - 2; k >= 0; --k) {
+				Object tmp(c[k + 1]);
+				tmp -= c[k];
+				tmp *= z;
+				c[k] = tmp;
+			}
+		}
+		
+		static void evaluate (const Object *const *const *coeff, const CubicBSplineAxis axis[3],
+			const double ivsize[3], const Object& zero, Object& out, Object *grad) {
+			Object value(zero);
+			Object d[3];
+			for (int m = 0; m < 3; ++m) {
+				d[m] = value;
+			}
+			for (int a = 0; a < 4; ++a) {
+				for (int b = 0; b < 4; ++b) {
+					const Object *row = coeff[axis[0].index[a]][axis[1].index[b]];
+					for (int c = 0; c < 4; ++c) {
+						const Object& p = row[axis[2].index[c]];
+						value += (axis[0].weight[a] * axis[1].weight[b] * axis[2].weight[c]) * p;
+						if (grad != NULL) {
+							d[0] += (axis[0].deriv[a] * axis[1].weight[b] * axis[2].weight[c] * ivsize[0]) * p;
+							d[1] += (axis[0].weight[a] * axis[1].deriv[b] * axis[2].weight[c] * ivsize[1]) * p;
+							d[2] += (axis[0].weight[a] * axis[1].weight[b] * axis[2].deriv[c] * ivsize[2]) * p;
+						}
+					}
+				}
+			}
+			out = value;
+			if (grad != NULL) {
+				for (int m = 0; m < 3; ++m) {
+					grad[m] = d[m];
+				}
+			}
+		}
+	};
+	
+	// the specializations read the rows of objects as rows of
+	// components: Vector3D and SymTensor3D hold nothing but their
+	// components and have no virtual functions; they need no zero
+	template <>
+	inline void CubicBSplineInterpolation<double>::evaluate (const double *const *const *coeff,
+		const CubicBSplineAxis axis[3], const double ivsize[3], const double& /* zero */, double& out, double *grad) {
+		double *g[3] = {grad, grad + 1, grad + 2};
+		cubicBSplineComponents<1>(coeff, axis, ivsize, &out, grad != NULL ? g : NULL);
+	}
+	
+	template <>
+	inline void CubicBSplineInterpolation<Vector3D>::evaluate (const Vector3D *const *const *coeff,
+		const CubicBSplineAxis axis[3], const double ivsize[3], const Vector3D& /* zero */, Vector3D& out, Vector3D *grad) {
+		double *g[3] = {NULL, NULL, NULL};
+		if (grad != NULL) {
+			for (int m = 0; m < 3; ++m) {
+				g[m] = &grad[m][0];
+			}
+		}
+		cubicBSplineComponents<3>(reinterpret_cast<const double *const *const *>(coeff), axis, ivsize, &out[0], grad != NULL ? g : NULL);
+	}
+	
+	template <>
+	inline void CubicBSplineInterpolation<SymTensor3D>::evaluate (const SymTensor3D *const *const *coeff,
+		const CubicBSplineAxis axis[3], const double ivsize[3], const SymTensor3D& /* zero */, SymTensor3D& out, SymTensor3D *grad) {
+		double *g[3] = {NULL, NULL, NULL};
+		if (grad != NULL) {
+			for (int m = 0; m < 3; ++m) {
+				g[m] = &grad[m][0];
+			}
+		}
+		cubicBSplineComponents<6>(reinterpret_cast<const double *const *const *>(coeff), axis, ivsize, &out[0], grad != NULL ? g : NULL);
+	}
+}
+
+#endif
@@ -60,6 +60,8 @@ namespace volume {
 		DeformationField3D& leftCompositionWith (const Affine3D& aff);
 		DeformationField3D& rightCompositionWith (const Affine3D& aff);
 		DeformationField3D& rightCompositionWith (const DeformationField3D& lhs);
+		// these use currentJacobian and are not thread safe; see
+		// JacobianField for the parallel computation
 		void getCurrentJacobian (Matrix3D& jac) const;
 		ScalarVolume *getJacobian (const bool useLog, const ScalarVolume *mask = NULL) const;
 		void getJacobianComponents (ScalarVolume *jcs[3], const SymTensor3DVolume& altas, const ScalarVolume& mask) const;
@@ -28,6 +28,7 @@
 #define _volume_DeformationSymTensor3DVolume_H
 
 #include "DeformationField3D.h"
+#include "RotationField.h"
 #include "Transformation.h"
 #include "TransformSymTensor3DVolume.h"
 
@@ -57,6 +58,91 @@ namespace volume {
 		void setTransformation (const char *filename);
 		void setTransformation (const char *filename, const bool flip[3]);
 		
+		// backward resampling onto out, in the voxel space of the
+		// deformation field, with the FS reorientation read from a
+		// rotation field built from it.  unlike computeTransform, nothing
+		// is kept in the Transformation members, so the voxels are
+		// resampled in parallel.  with PPD, which depends on the tensor,
+		// the jacobian is computed at every voxel instead, and the loop is
+		// serial: PPDTransformByEqual is not known to be thread safe
+		void computeTransformWith (const RotationField& rotation, Volume<SymTensor3D>& out, const int intp = 0) {
+			int sz[3];
+			double vsize[3];
+			double outVSize[3];
+			double origin[3];
+			double outOrigin[3];
+			out.getSize(sz);
+			trans.getVSize(vsize);
+			trans.getOrigin(origin);
+			out.getVSize(outVSize);
+			out.getOrigin(outOrigin);
+			bool same = trans.checkSize(sz);
+			for (int m = 0; m < 3; ++m) {
+				if (fabs(outVSize[m] - vsize[m]) > 1e-6 || fabs(outOrigin[m] - origin[m]) > 1e-6) {
+					same = false;
+				}
+			}
+			if (!same) {
+				cerr << "The output must have the size, voxel size and origin of the deformation field" << endl;
+				exit(1);
+			}
+			if (!rotation.matches(trans)) {
+				cerr << "The rotation field was not built from a deformation field of this size, voxel size and origin" << endl;
+				exit(1);
+			}
+			
+			const bool lei = intp == 0 && SymTensor3D::InterpolationOption == SymTensor3D::LEI;
+			if (lei) {
+				log();
+				const double value = std::log(0.001);
+				SymTensor3D bg(value, 0.0, value, 0.0, 0.0, value);
+				this->setBackground(bg);
+				out.setBackground(bg);
+			}
+			
+			if (intp == 2) {
+				this->ensureBSplineCoefficients();
+			}
+			
+			cout << "backward resampling with a rotation field ..." << flush;
+			ScopedTimer timer("DeformationSymTensor3DVolume::computeTransformWith");
+			timer.addVoxels((unsigned long long)sz[0] * sz[1] * sz[2]);
+			const SymTensor3D::Reorient reorient = SymTensor3D::ReorientOption;
+#ifdef _OPENMP
+#pragma omp parallel for if (reorient != SymTensor3D::PPD)
+#endif
+			for (int i = 0; i < sz[0]; ++i) {
+				Vector3D vec;
+				Matrix3D rot;
+				double jac[3][3];
+				for (int j = 0; j < sz[1]; ++j) {
+					for (int k = 0; k < sz[2]; ++k) {
+						vec[0] = i;
+						vec[1] = j;
+						vec[2] = k;
+						out.toAbs(vec);
+						vec += trans.voxel[i][j][k];
+						if (!this->getVoxelAt(vec, out.voxel[i][j][k], intp)) {
+							continue;
+						}
+						if (reorient == SymTensor3D::FS) {
+							rotation.getRotation(i, j, k, rot);
+							out.voxel[i][j][k].similarityTransformByEqual(rot);
+						} else if (reorient == SymTensor3D::PPD) {
+							JacobianField::computeAt(trans, sz, vsize, i, j, k, jac);
+							out.voxel[i][j][k].PPDTransformByEqual(Matrix3D(jac).inverse());
+						}
+					}
+				}
+			}
+			cout << "time consumed = " << timer.elapsed() << endl;
+			
+			if (lei) {
+				exp();
+				out.exp();
+			}
+		}
+		
 	};
 	
 }
@@ -0,0 +1,444 @@
+/*============================================================================
+
+  Program:     DTI ToolKit (DTI-TK)
+  Module:      $RCSfile: FloatVolume.h,v $
+  Language:    C++
+  Date:        $Date: 2026/10/18 16:31:44 $
+  Version:     $Revision: 1.1 $
+
+  Copyright (c) Gary Hui Zhang (garyhuizhang@gmail.com).
+  All rights reserverd.
+
+  DTI-TK is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  DTI-TK is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with DTI-TK.  If not, see <http://www.gnu.org/licenses/>.
+============================================================================*/
+
+
+// template FloatVolume<class Object>
+//
+// declaration and implementation
+//
+// single precision storage of the image data of a Volume<Object>, for
+// double, Vector3D and SymTensor3D.  the components are packed in one
+// contiguous float buffer, k fastest as in Volume, at half the memory
+// and bandwidth of a Volume.  the input of fsl_to_dtitk is float nifti,
+// so nothing is lost in storage.
+//
+// it is a storage class of its own, not a storage mode of Volume: Volume
+// and SymTensor3D still hold double, and so does every registration,
+// similarity, gradient and TransformVolume loop.  only the code reading
+// a FloatVolume gains, at present the scalar maps of
+// MultiVolumeResampler and the interpolation kernel of KernelBenchmark.
+//
+// a FloatVolume is either converted from a Volume or read from nifti
+// directly, never holding the volume in double:
+//
+//   FloatVolume<double> fa("subject_fa.nii.gz");
+//   FloatVolume<SymTensor3D> dti("subject.nii.gz");
+//
+// the orientation is brought to LPI as when reading a Volume, with the
+// vectors and the tensors reoriented accordingly.
+//
+// the interpolation reads float and accumulates in double, and returns
+// double Objects: the similarity sums, gradients and transformation
+// parameters built on top of it stay in double.  the interpolation
+// follows Volume: same range test, background beyond the volume, same
+// order of operations as TrilinearInterpolation.
+
+#ifndef _volume_FloatVolume_H
+#define _volume_FloatVolume_H
+
+#include "Volume.h"
+#include <vector>
+
+namespace volume {
+	
+	using namespace std;
+	
+	// access to the components of the supported objects
+	template <class Object>
+	struct FloatVolumeComponents;
+	
+	// intent is the nifti intent code of the volumes of the object and
+	// orient the reorientation of an object to LPI, as done by
+	// Volume::objectSpecificOrientationMapping
+	template <>
+	struct FloatVolumeComponents<double> {
+		enum { N = 1 };
+		static const double *get (const double& o) {
+			return &o;
+		}
+		static double *get (double& o) {
+			return &o;
+		}
+		static int intent () {
+			return 0;
+		}
+		static void orient (double *, const int [3], const bool [3]) {}
+	};
+	
+	template <>
+	struct FloatVolumeComponents<Vector3D> {
+		enum { N = 3 };
+		static const double *get (const Vector3D& o) {
+			return &o[0];
+		}
+		static double *get (Vector3D& o) {
+			return &o[0];
+		}
+		static int intent () {
+			return NIFTI_INTENT_VECTOR;
+		}
+		static void orient (double *c, const int mapping[3], const bool dir[3]) {
+			double input[3];
+			for (int m = 0; m < 3; ++m) {
+				input[m] = c[m];
+			}
+			for (int m = 0; m < 3; ++m) {
+				c[mapping[m]] = dir[m] ? input[m] : -input[m];
+			}
+		}
+	};
+	
+	template <>
+	struct FloatVolumeComponents<SymTensor3D> {
+		enum { N = 6 };
+		static const double *get (const SymTensor3D& o) {
+			return &o[0];
+		}
+		static double *get (SymTensor3D& o) {
+			return &o[0];
+		}
+		static int intent () {
+			return NIFTI_INTENT_SYMMATRIX;
+		}
+		// as TransformSymTensor3DVolume, on the lower triangle
+		static void orient (double *c, const int mapping[3], const bool dir[3]) {
+			double input[3][3];
+			input[0][0] = c[0];
+			input[1][0] = c[1];
+			input[1][1] = c[2];
+			input[2][0] = c[3];
+			input[2][1] = c[4];
+			input[2][2] = c[5];
+			double output[3][3];
+			for (int m = 0; m < 3; ++m) {
+				for (int n = 0; n <= m; ++n) {
+					const double v = (dir[m] == dir[n]) ? input[m][n] : -input[m][n];
+					output[mapping[m]][mapping[n]] = v;
+					output[mapping[n]][mapping[m]] = v;
+				}
+			}
+			c[0] = output[0][0];
+			c[1] = output[1][0];
+			c[2] = output[1][1];
+			c[3] = output[2][0];
+			c[4] = output[2][1];
+			c[5] = output[2][2];
+		}
+	};
+	
+	template <class Object>
+	class FloatVolume : public VoxelSpace {
+		typedef FloatVolumeComponents<Object> Components;
+		enum { N = Components::N };
+		
+		protected:
+		vector<float> data;
+		
+		// the background, kept in float like the voxels
+		float bg[N];
+		
+		size_t offset (const int i, const int j, const int k) const {
+			return (((size_t)i * size[1] + j) * size[2] + k) * N;
+		}
+		
+		const float *corner (const int i, const int j, const int k) const {
+			if (i < 0 || i >= size[0] || j < 0 || j >= size[1] || k < 0 || k >= size[2]) {
+				return bg;
+			}
+			return &data[offset(i, j, k)];
+		}
+		
+		void interpolate (const int b[3], const double lambda[3], Object& out) const {
+			const float *c000 = corner(b[0], b[1], b[2]);
+			const float *c001 = corner(b[0] + 1, b[1], b[2]);
+			const float *c010 = corner(b[0], b[1] + 1, b[2]);
+			const float *c011 = corner(b[0] + 1, b[1] + 1, b[2]);
+			const float *c100 = corner(b[0], b[1], b[2] + 1);
+			const float *c101 = corner(b[0] + 1, b[1], b[2] + 1);
+			const float *c110 = corner(b[0], b[1] + 1, b[2] + 1);
+			const float *c111 = corner(b[0] + 1, b[1] + 1, b[2] + 1);
+			const double lx = lambda[0];
+			const double ly = lambda[1];
+			const double lz = lambda[2];
+			const double mx = 1 - lx;
+			const double my = 1 - ly;
+			const double mz = 1 - lz;
+			double *o = Components::get(out);
+			for (int m = 0; m < N; ++m) {
+				const double c00 = c000[m] * mx + lx * c001[m];
+				const double c01 = c010[m] * mx + lx * c011[m];
+				const double c10 = c100[m] * mx + lx * c101[m];
+				const double c11 = c110[m] * mx + lx * c111[m];
+				const double c0 = c00 * my + ly * c01;
+				const double c1 = c10 * my + ly * c11;
+				o[m] = c0 * mz + lz * c1;
+			}
+		}
+		
+		void setBackground (const Object& in) {
+			const double *c = Components::get(in);
+			for (int m = 0; m < N; ++m) {
+				bg[m] = (float)c[m];
+			}
+		}
+		
+		// map nifti data to the float buffer, as
+		// Volume::convertNiftiDataToVectorialVoxel
+		template <class PixelType>
+		void convertNiftiData (const nifti_image *nim) {
+			int mapping[3];
+			bool dir[3];
+			convertToLPI(nim, mapping, dir);
+			int isize[3];
+			getSize(isize);
+			remap(mapping);
+			data.resize((size_t)size[0] * size[1] * size[2] * N);
+			const PixelType *in = (const PixelType *)(nim->data);
+			int iidx[3];
+			int nidx[3];
+			size_t index = 0;
+			for (int m = 0; m < N; ++m) {
+				for (iidx[2] = 0; iidx[2] < isize[2]; ++iidx[2]) {
+					nidx[mapping[2]] = dir[2] ? iidx[2] : isize[2] - 1 - iidx[2];
+					for (iidx[1] = 0; iidx[1] < isize[1]; ++iidx[1]) {
+						nidx[mapping[1]] = dir[1] ? iidx[1] : isize[1] - 1 - iidx[1];
+						for (iidx[0] = 0; iidx[0] < isize[0]; ++iidx[0]) {
+							nidx[mapping[0]] = dir[0] ? iidx[0] : isize[0] - 1 - iidx[0];
+							double v = in[index];
+							if (nim->scl_slope != 0) {
+								v = v * nim->scl_slope + nim->scl_inter;
+							}
+							data[offset(nidx[0], nidx[1], nidx[2]) + m] = (float)v;
+							++index;
+						}
+					}
+				}
+			}
+			if (N == 1) {
+				return;
+			}
+			// the reorientation of the objects
+			const size_t voxels = (size_t)size[0] * size[1] * size[2];
+			for (size_t v = 0; v < voxels; ++v) {
+				double c[N];
+				for (int m = 0; m < N; ++m) {
+					c[m] = data[v * N + m];
+				}
+				Components::orient(c, mapping, dir);
+				for (int m = 0; m < N; ++m) {
+					data[v * N + m] = (float)c[m];
+				}
+			}
+		}
+		
+		public:
+		// read a nifti volume straight into float storage
+		FloatVolume (const char *filename) : VoxelSpace() {
+			cout << "Reading " << filename << " ... " << flush;
+			ScopedTimer timer("FloatVolume::readNifti");
+			nifti_image *nim = fromNifti(filename, N, Components::intent());
+			if (nim == NULL) {
+				cerr << "Fail to load the volume " << filename << endl;
+				exit(1);
+			}
+			timer.addBytes((unsigned long long)nim->nvox * nim->nbyper);
+			switch (nim->datatype) {
+				case DT_UINT8:
+					convertNiftiData<unsigned char>(nim);
+					break;
+				case DT_INT8:
+					convertNiftiData<char>(nim);
+					break;
+				case DT_UINT16:
+					convertNiftiData<unsigned short>(nim);
+					break;
+				case DT_INT16:
+					convertNiftiData<short>(nim);
+					break;
+				case DT_UINT32:
+					convertNiftiData<unsigned int>(nim);
+					break;
+				case DT_INT32:
+					convertNiftiData<int>(nim);
+					break;
+				case DT_UINT64:
+					convertNiftiData<unsigned long>(nim);
+					break;
+				case DT_INT64:
+					convertNiftiData<long>(nim);
+					break;
+				case DT_FLOAT32:
+					convertNiftiData<float>(nim);
+					break;
+				case DT_FLOAT64:
+					convertNiftiData<double>(nim);
+					break;
+				case DT_FLOAT128:
+					convertNiftiData<long double>(nim);
+					break;
+				default:
+					cerr << "Unsupported datatype : " << nim->datatype << endl;
+					exit(1);
+			}
+			nifti_image_free(nim);
+			for (int m = 0; m < N; ++m) {
+				bg[m] = 0.0f;
+			}
+			setRegion();
+			cout << "Done in " << timer.elapsed() << 's' << endl;
+		}
+		
+		// convert the image data of vol
+		FloatVolume (const Volume<Object>& vol) : VoxelSpace(vol) {
+			Object b;
+			vol.getBackground(b);
+			setBackground(b);
+			data.resize((size_t)size[0] * size[1] * size[2] * N);
+			for (int i = 0; i < size[0]; ++i) {
+				for (int j = 0; j < size[1]; ++j) {
+					float *row = &data[offset(i, j, 0)];
+					for (int k = 0; k < size[2]; ++k) {
+						const double *c = Components::get(vol.voxel[i][j][k]);
+						for (int m = 0; m < N; ++m) {
+							row[k * N + m] = (float)c[m];
+						}
+					}
+				}
+			}
+		}
+		
+		~FloatVolume () {}
+		
+		// back to double storage; out must have the same size
+		void toVolume (Volume<Object>& out) const {
+			if (!out.checkSize(size)) {
+				cerr << "FloatVolume::toVolume: the output size does not match" << endl;
+				exit(1);
+			}
+			for (int i = 0; i < size[0]; ++i) {
+				for (int j = 0; j < size[1]; ++j) {
+					const float *row = &data[offset(i, j, 0)];
+					for (int k = 0; k < size[2]; ++k) {
+						double *c = Components::get(out.voxel[i][j][k]);
+						for (int m = 0; m < N; ++m) {
+							c[m] = row[k * N + m];
+						}
+					}
+				}
+			}
+		}
+		
+		void getBackground (Object& out) const {
+			double *o = Components::get(out);
+			for (int m = 0; m < N; ++m) {
+				o[m] = bg[m];
+			}
+		}
+		
+		// the storage in bytes
+		size_t getMemorySize () const {
+			return data.size() * sizeof(float);
+		}
+		
+		void getVoxel (const int i, const int j, const int k, Object& out) const {
+			const float *c = &data[offset(i, j, k)];
+			double *o = Components::get(out);
+			for (int m = 0; m < N; ++m) {
+				o[m] = c[m];
+			}
+		}
+		
+		// the backward resampling function, as Volume::getVoxelAt
+		bool getVoxelAt (const Vector3D& vec, Object& out, const int intp = 0) const {
+			if (intp != 0) {
+				// nearest neighbour interpolation
+				Vector3D loc(vec);
+				toRel(loc);
+				int idx[3];
+				for (int m = 0; m < 3; ++m) {
+					if (loc[m] > -0.5 && loc[m] < size[m] - 0.5) {
+						idx[m] = (int)round(loc[m]);
+					} else {
+						getBackground(out);
+						return false;
+					}
+				}
+				getVoxel(idx[0], idx[1], idx[2], out);
+				return true;
+			}
+			int bottomLeft[3];
+			double lambda[3];
+			if (computeBottomLeftCornerIndexAndLambdaRegion(vec, bottomLeft, lambda)) {
+				interpolate(bottomLeft, lambda, out);
+				return true;
+			}
+			getBackground(out);
+			return false;
+		}
+		
+		// backward resampling along a line, as Volume::getVoxelRun
+		void getVoxelRun (const Vector3D& vec, const Vector3D& inc, const int n,
+			Object *out, bool *inside, const int intp = 0) const {
+			Vector3D rel(vec);
+			toRel(rel);
+			Vector3D relInc(vec);
+			relInc += inc;
+			toRel(relInc);
+			relInc -= rel;
+			
+			double lo[3];
+			double hi[3];
+			for (int m = 0; m < 3; ++m) {
+				lo[m] = regionOriginRel[m];
+				hi[m] = regionEndRel[m] - 1;
+			}
+			
+			int b[3];
+			double lambda[3];
+			for (int t = 0; t < n; ++t) {
+				const double x = rel[0] + t * relInc[0];
+				const double y = rel[1] + t * relInc[1];
+				const double z = rel[2] + t * relInc[2];
+				if (intp != 0 || x < lo[0] || x >= hi[0] || y < lo[1] || y >= hi[1] || z < lo[2] || z >= hi[2]) {
+					Vector3D loc(inc);
+					loc *= t;
+					loc += vec;
+					inside[t] = getVoxelAt(loc, out[t], intp);
+					continue;
+				}
+				b[0] = (int)x;
+				b[1] = (int)y;
+				b[2] = (int)z;
+				lambda[0] = x - b[0];
+				lambda[1] = y - b[1];
+				lambda[2] = z - b[2];
+				interpolate(b, lambda, out[t]);
+				inside[t] = true;
+			}
+		}
+	};
+}
+
+#endif
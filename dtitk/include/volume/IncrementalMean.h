@@ -0,0 +1,375 @@
+/*============================================================================
+
+  Program:     DTI ToolKit (DTI-TK)
+  Module:      $RCSfile: IncrementalMean.h,v $
+  Language:    C++
+  Date:        $Date: 2026/10/18 10:12:40 $
+  Version:     $Revision: 1.1 $
+
+  Copyright (c) Gary Hui Zhang (garyhuizhang@gmail.com).
+  All rights reserverd.
+
+  DTI-TK is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  DTI-TK is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with DTI-TK.  If not, see <http://www.gnu.org/licenses/>.
+============================================================================*/
+
+
+// template IncrementalMean<class VolumeType>
+//
+// declaration and implementation
+//
+// running-sum template builder that persists across the iterations
+// of the population scripts.  the sum of the resampled subjects is
+// kept on disk together with a state file that records, for every
+// subject, the affine transformation its current contribution was
+// resampled with.  a new template only needs the subjects whose
+// transformation moved by more than a threshold to be resampled
+// again: their stale contribution is subtracted from the sum and
+// the new one added.
+//
+// VolumeType is expected to be SymTensor3DVolume or ScalarVolume
+// (anything constructible from a filename or a size and providing
+// writeVolAs, log and exp).
+//
+// no tool nor population script uses it yet: TVMean is built from
+// sources that are not part of this tree, and the scripts still
+// resample every subject and average them with TVMean.
+//
+// the state file is plain text:
+//   sum <filename of the running sum>
+//   updates <number of incremental updates since the last rebuild>
+//   log <1 if the sum is in the log domain, 0 otherwise>
+//   <subject> <12 numbers: the affine matrix row by row, then the vector>
+//   ...
+//
+// the sum alternates between two files, state_sum0.nii.gz and
+// state_sum1.nii.gz.  save writes the one the state does not refer to,
+// then the state to a temporary file renamed over the old one, so a
+// crash at any point leaves a state and a sum that agree.
+
+#ifndef _volume_IncrementalMean_H
+#define _volume_IncrementalMean_H
+
+#include "../geometry/Affine3D.h"
+#include "VoxelSpace.h"
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <map>
+#include <cstdio>
+#include <unistd.h>
+
+namespace volume {
+	
+	using namespace geometry;
+	using namespace std;
+	
+	template <class VolumeType>
+	class IncrementalMean {
+		protected:
+		// the state file and the running sum volume
+		string stateFile;
+		VolumeType *sum;
+		
+		// the two files the sum alternates between and the one the
+		// state on disk refers to, empty if there is none
+		string sumFiles[2];
+		string sumFile;
+		
+		// the transformation each subject is currently contributing with
+		map<string, Affine3D> contributions;
+		
+		// number of subtract/add updates applied since the sum
+		// was last built from scratch.  the sum is saved as float
+		// nifti so round-off accumulates with every update
+		int updates;
+		
+		// whether the tensors are averaged in the log domain
+		bool useLog;
+		
+		// the domain conversion applied to every contribution
+		void prepare (VolumeType& vol) const {
+			if (useLog) {
+				vol.log();
+			}
+		}
+		
+		void initSum (const VolumeType& vol) {
+			int sz[3];
+			double vsz[3];
+			double org[3];
+			vol.getSize(sz);
+			vol.getVSize(vsz);
+			vol.getOrigin(org);
+			sum = new VolumeType(sz);
+			sum->setVSize(vsz);
+			sum->setOrigin(org);
+			*sum = vol;
+		}
+		
+		public:
+		IncrementalMean (const char *state, const bool logDomain = false) : stateFile(state) {
+			sum = NULL;
+			updates = 0;
+			useLog = logDomain;
+			// state.txt -> state_sum0.nii.gz and state_sum1.nii.gz
+			const string base = stateFile.substr(0, stateFile.rfind('.'));
+			sumFiles[0] = base + "_sum0.nii.gz";
+			sumFiles[1] = base + "_sum1.nii.gz";
+		}
+		
+		~IncrementalMean () {
+			if (sum != NULL) {
+				delete sum;
+			}
+		}
+		
+		int getNoOfSubjects () const {
+			return contributions.size();
+		}
+		
+		int getNoOfUpdates () const {
+			return updates;
+		}
+		
+		bool contains (const string& subject) const {
+			return contributions.find(subject) != contributions.end();
+		}
+		
+		// load the state and the running sum
+		// returns false if there is no usable state yet
+		bool load () {
+			ifstream in(stateFile.c_str());
+			if (!in) {
+				return false;
+			}
+			
+			string key;
+			string line;
+			string file;
+			int logDomain = 0;
+			in >> key >> file;
+			if (key != "sum") {
+				cerr << "Invalid state file " << stateFile << endl;
+				return false;
+			}
+			in >> key >> updates;
+			if (key != "updates") {
+				cerr << "Invalid state file " << stateFile << endl;
+				return false;
+			}
+			in >> key >> logDomain;
+			if (key != "log") {
+				cerr << "Invalid state file " << stateFile << endl;
+				return false;
+			}
+			if ((logDomain != 0) != useLog) {
+				cerr << "The running sum of " << stateFile << " is ";
+				cerr << (logDomain != 0 ? "in the log domain" : "not in the log domain");
+				cerr << ", unlike the one requested" << endl;
+				return false;
+			}
+			getline(in, line);
+			
+			contributions.clear();
+			while (getline(in, line)) {
+				if (line.size() == 0) {
+					continue;
+				}
+				istringstream iss(line);
+				string subject;
+				double para[12];
+				iss >> subject;
+				for (int i = 0; i < 12; ++i) {
+					iss >> para[i];
+				}
+				if (!iss) {
+					cerr << "Invalid entry in the state file " << stateFile;
+					cerr << " : " << line << endl;
+					return false;
+				}
+				Matrix3D mat;
+				for (int i = 0; i < 3; ++i) {
+					for (int j = 0; j < 3; ++j) {
+						mat.setElement(i, j, para[3*i + j]);
+					}
+				}
+				contributions[subject] = Affine3D(Vector3D(para[9], para[10], para[11]), mat);
+			}
+			
+			if (sum != NULL) {
+				delete sum;
+			}
+			sum = new VolumeType(file.c_str());
+			sumFile = file;
+			return true;
+		}
+		
+		// save the state and the running sum
+		bool save () {
+			if (sum == NULL) {
+				cerr << "Fail to save the state: the running sum is empty" << endl;
+				return false;
+			}
+			const string next = sumFile == sumFiles[0] ? sumFiles[1] : sumFiles[0];
+			if (!sum->writeVolAs(next.c_str())) {
+				return false;
+			}
+			
+			ostringstream tmp;
+			tmp << stateFile << '.' << getpid() << ".tmp";
+			const string tmpFile = tmp.str();
+			ofstream out(tmpFile.c_str());
+			if (!out) {
+				cerr << "Fail to write the state file " << tmpFile << endl;
+				return false;
+			}
+			out << "sum " << next << endl;
+			out << "updates " << updates << endl;
+			out << "log " << (useLog ? 1 : 0) << endl;
+			out << setprecision(12);
+			typename map<string, Affine3D>::const_iterator it;
+			for (it = contributions.begin(); it != contributions.end(); ++it) {
+				Matrix3D mat;
+				Vector3D vec;
+				it->second.getMatrix(mat);
+				it->second.getVector(vec);
+				out << it->first;
+				for (int i = 0; i < 3; ++i) {
+					for (int j = 0; j < 3; ++j) {
+						out << ' ' << mat.getElement(i, j);
+					}
+				}
+				for (int i = 0; i < 3; ++i) {
+					out << ' ' << vec[i];
+				}
+				out << endl;
+			}
+			out.close();
+			if (!out || rename(tmpFile.c_str(), stateFile.c_str()) != 0) {
+				cerr << "Fail to write the state file " << stateFile << endl;
+				remove(tmpFile.c_str());
+				return false;
+			}
+			
+			// the previous sum is no longer referred to
+			if (!sumFile.empty() && sumFile != next) {
+				remove(sumFile.c_str());
+			}
+			sumFile = next;
+			return true;
+		}
+		
+		// the largest displacement between two affine transformations
+		// over the corners of the voxel space, in mm
+		//
+		// an affine difference attains its maximum norm over a box
+		// at one of its corners
+		static double computeMaxCornerDisplacement (const Affine3D& a1, const Affine3D& a2, const VoxelSpace& vs) {
+			int sz[3];
+			vs.getSize(sz);
+			double maxDisp = 0.0;
+			for (int c = 0; c < 8; ++c) {
+				Vector3D corner((c & 1) ? sz[0] - 1 : 0, (c & 2) ? sz[1] - 1 : 0, (c & 4) ? sz[2] - 1 : 0);
+				vs.toAbs(corner);
+				Vector3D disp = a1 * corner;
+				disp -= a2 * corner;
+				const double norm = disp.norm();
+				if (norm > maxDisp) {
+					maxDisp = norm;
+				}
+			}
+			return maxDisp;
+		}
+		
+		// whether the subject needs to be resampled and its contribution
+		// updated, given its new transformation and the template space
+		bool requiresUpdate (const string& subject, const Affine3D& trans, const VoxelSpace& vs, const double threshold) const {
+			typename map<string, Affine3D>::const_iterator it = contributions.find(subject);
+			if (it == contributions.end()) {
+				return true;
+			}
+			return computeMaxCornerDisplacement(it->second, trans, vs) > threshold;
+		}
+		
+		// add a new subject to the running sum
+		// vol is consumed (converted to the log domain if required)
+		void add (const string& subject, VolumeType& vol, const Affine3D& trans) {
+			if (contains(subject)) {
+				cerr << subject << " is already in the running sum" << endl;
+				exit(1);
+			}
+			prepare(vol);
+			if (sum == NULL) {
+				initSum(vol);
+			} else {
+				*sum += vol;
+			}
+			contributions[subject] = trans;
+		}
+		
+		// replace the stale contribution of a subject by a new one
+		// both volumes are consumed
+		void replace (const string& subject, VolumeType& stale, VolumeType& fresh, const Affine3D& trans) {
+			if (!contains(subject) || sum == NULL) {
+				cerr << subject << " is not in the running sum" << endl;
+				exit(1);
+			}
+			prepare(stale);
+			prepare(fresh);
+			*sum -= stale;
+			*sum += fresh;
+			contributions[subject] = trans;
+			++updates;
+		}
+		
+		// drop the running sum; the next add starts a rebuild
+		void clear () {
+			if (sum != NULL) {
+				delete sum;
+				sum = NULL;
+			}
+			contributions.clear();
+			updates = 0;
+		}
+		
+		// the template from the running sum
+		// the caller owns the returned volume
+		VolumeType *computeMean () const {
+			if (sum == NULL || contributions.size() == 0) {
+				cerr << "The running sum is empty" << endl;
+				exit(1);
+			}
+			int sz[3];
+			double vsz[3];
+			double org[3];
+			sum->getSize(sz);
+			sum->getVSize(vsz);
+			sum->getOrigin(org);
+			VolumeType *mean = new VolumeType(sz);
+			mean->setVSize(vsz);
+			mean->setOrigin(org);
+			*mean = *sum;
+			*mean *= 1.0/contributions.size();
+			if (useLog) {
+				mean->exp();
+			}
+			return mean;
+		}
+	};
+
+}
+
+#endif
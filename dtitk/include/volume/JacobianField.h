@@ -0,0 +1,236 @@
+/*============================================================================
+
+  Program:     DTI ToolKit (DTI-TK)
+  Module:      $RCSfile: JacobianField.h,v $
+  Language:    C++
+  Date:        $Date: 2026/10/18 21:12:05 $
+  Version:     $Revision: 1.1 $
+
+  Copyright (c) Gary Hui Zhang (garyhuizhang@gmail.com).
+  All rights reserverd.
+
+  DTI-TK is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  DTI-TK is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with DTI-TK.  If not, see <http://www.gnu.org/licenses/>.
+============================================================================*/
+
+
+// class JacobianField
+//
+// declaration and implementation
+//
+// the Jacobian of a displacement field, computed without any state kept
+// in the field: every voxel only reads the displacements of its
+// neighbours, so the voxels are computed in parallel.  the Jacobian is
+// the identity plus the gradient of the displacement, with central
+// differences and a zero displacement outside the volume, as
+// dfToJacobian: the determinants agree with its output to the float
+// precision of the file, borders included.
+//
+// compute fills in one pass any of the determinant, its log and the nine
+// components of the Jacobian matrix:
+//
+//   ScalarVolume det(df), logDet(df);
+//   JacobianField::compute(df, &det, &logDet, NULL, &mask);
+//
+// computeStatistics reduces the determinant over a mask without
+// allocating any volume, for the check made after every iteration of the
+// deformable registration:
+//
+//   JacobianField::Statistics stats = JacobianField::computeStatistics(df, &mask);
+//   JacobianField::report(stats, cout);
+//   if (!JacobianField::isWithin(stats, 0.0, 10.0)) { ... }
+//
+// report prints the mean, min and max in the same fields as the line of
+// SVtool -stats the scripts parse (min is the 6th, max the 9th).  min
+// and max are those of SVtool on the output of dfToJacobian; its mean
+// leaves one voxel out of the sum and may differ by up to max/count.
+
+#ifndef _volume_JacobianField_H
+#define _volume_JacobianField_H
+
+#include "DeformationField3D.h"
+#include "ScalarVolume.h"
+#include <iostream>
+#include <cmath>
+#include <cfloat>
+
+namespace volume {
+	
+	using namespace std;
+	
+	class JacobianField {
+		public:
+		// statistics of the determinant inside the mask
+		struct Statistics {
+			double mean;
+			double stdev;
+			double min;
+			double max;
+			long count;
+		};
+		
+		// the Jacobian matrix at voxel (i, j, k)
+		static void computeAt (const DeformationField3D& df, const int size[3], const double vsize[3], const int i, const int j, const int k, double jac[3][3]) {
+			const int index[3] = {i, j, k};
+			const Vector3D zero(0.0, 0.0, 0.0);
+			for (int c = 0; c < 3; ++c) {
+				int lo[3] = {i, j, k};
+				int hi[3] = {i, j, k};
+				--lo[c];
+				++hi[c];
+				const Vector3D& u0 = index[c] > 0 ? df.voxel[lo[0]][lo[1]][lo[2]] : zero;
+				const Vector3D& u1 = index[c] < size[c] - 1 ? df.voxel[hi[0]][hi[1]][hi[2]] : zero;
+				for (int r = 0; r < 3; ++r) {
+					jac[r][c] = (u1[r] - u0[r]) / (2.0 * vsize[c]);
+				}
+			}
+			for (int r = 0; r < 3; ++r) {
+				jac[r][r] += 1.0;
+			}
+		}
+		
+		static double det (const double m[3][3]) {
+			return m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1])
+				- m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0])
+				+ m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+		}
+		
+		// the outputs left NULL are not computed; the components are
+		// ordered row by row.  outside the mask, the outputs are zero.
+		// the log of a non-positive determinant (a folding) is set to zero
+		static void compute (const DeformationField3D& df, ScalarVolume *detOut, ScalarVolume *logDetOut, ScalarVolume *components[9], const ScalarVolume *mask = NULL) {
+			int size[3];
+			double vsize[3];
+			df.getSize(size);
+			df.getVSize(vsize);
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+			for (int i = 0; i < size[0]; ++i) {
+				double jac[3][3];
+				for (int j = 0; j < size[1]; ++j) {
+					for (int k = 0; k < size[2]; ++k) {
+						if (mask && mask->voxel[i][j][k] <= 0.0) {
+							if (detOut) {
+								detOut->voxel[i][j][k] = 0.0;
+							}
+							if (logDetOut) {
+								logDetOut->voxel[i][j][k] = 0.0;
+							}
+							if (components) {
+								for (int c = 0; c < 9; ++c) {
+									components[c]->voxel[i][j][k] = 0.0;
+								}
+							}
+							continue;
+						}
+						computeAt(df, size, vsize, i, j, k, jac);
+						const double d = det(jac);
+						if (detOut) {
+							detOut->voxel[i][j][k] = d;
+						}
+						if (logDetOut) {
+							logDetOut->voxel[i][j][k] = (d > 0.0) ? log(d) : 0.0;
+						}
+						if (components) {
+							for (int c = 0; c < 9; ++c) {
+								components[c]->voxel[i][j][k] = jac[c / 3][c % 3];
+							}
+						}
+					}
+				}
+			}
+		}
+		
+		static Statistics computeStatistics (const DeformationField3D& df, const ScalarVolume *mask = NULL) {
+			int size[3];
+			double vsize[3];
+			df.getSize(size);
+			df.getVSize(vsize);
+			double sum = 0.0, sumSq = 0.0;
+			double min = DBL_MAX, max = -DBL_MAX;
+			long count = 0;
+#ifdef _OPENMP
+#pragma omp parallel
+#endif
+			{
+				double localSum = 0.0, localSumSq = 0.0;
+				double localMin = DBL_MAX, localMax = -DBL_MAX;
+				long localCount = 0;
+				double jac[3][3];
+#ifdef _OPENMP
+#pragma omp for
+#endif
+				for (int i = 0; i < size[0]; ++i) {
+					for (int j = 0; j < size[1]; ++j) {
+						for (int k = 0; k < size[2]; ++k) {
+							if (mask && mask->voxel[i][j][k] <= 0.0) {
+								continue;
+							}
+							computeAt(df, size, vsize, i, j, k, jac);
+							const double d = det(jac);
+							localSum += d;
+							localSumSq += d * d;
+							if (d < localMin) {
+								localMin = d;
+							}
+							if (d > localMax) {
+								localMax = d;
+							}
+							++localCount;
+						}
+					}
+				}
+#ifdef _OPENMP
+#pragma omp critical
+#endif
+				{
+					sum += localSum;
+					sumSq += localSumSq;
+					if (localMin < min) {
+						min = localMin;
+					}
+					if (localMax > max) {
+						max = localMax;
+					}
+					count += localCount;
+				}
+			}
+			Statistics stats;
+			stats.count = count;
+			if (count == 0) {
+				stats.mean = stats.stdev = stats.min = stats.max = 0.0;
+				return stats;
+			}
+			stats.mean = sum / count;
+			const double var = sumSq / count - stats.mean * stats.mean;
+			stats.stdev = (var > 0.0) ? sqrt(var) : 0.0;
+			stats.min = min;
+			stats.max = max;
+			return stats;
+		}
+		
+		// whether the determinant stays within (lower, upper)
+		static bool isWithin (const Statistics& stats, const double lower, const double upper) {
+			return stats.min > lower && stats.max < upper;
+		}
+		
+		static void report (const Statistics& stats, ostream& out) {
+			out << "mean = " << stats.mean << " min = " << stats.min;
+			out << " max = " << stats.max << " std = " << stats.stdev;
+			out << " count = " << stats.count << endl;
+		}
+	};
+}
+
+#endif
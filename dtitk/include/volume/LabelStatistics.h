@@ -0,0 +1,237 @@
+/*============================================================================
+
+  Program:     DTI ToolKit (DTI-TK)
+  Module:      $RCSfile: LabelStatistics.h,v $
+  Language:    C++
+  Date:        $Date: 2026/10/18 23:41:52 $
+  Version:     $Revision: 1.1 $
+
+  Copyright (c) Gary Hui Zhang (garyhuizhang@gmail.com).
+  All rights reserverd.
+
+  DTI-TK is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  DTI-TK is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with DTI-TK.  If not, see <http://www.gnu.org/licenses/>.
+============================================================================*/
+
+
+// class LabelStatistics
+//
+// declaration and implementation
+//
+// statistics of several scalar volumes inside every label of a label
+// volume, e.g. FA and MD per atlas region, instead of one SVtool -stats
+// run per label and per volume with a mask built for the label:
+//
+//   LabelStatistics stats(parcellation, "subject01");
+//   stats.addVolume(fa, "fa");
+//   stats.addVolume(md, "md");
+//   stats.compute();
+//   stats.writeCSV("subject01_roi.csv");
+//
+// the label volume is read once to list the voxels of every label; the
+// labels are the voxel values rounded to integers and 0 is the
+// background.  the (label, volume) pairs are then computed in parallel,
+// each from the voxels of its label only.  for every pair: the count,
+// mean, standard deviation, min, max and the percentiles (5, 25, 50,
+// 75 and 95 by default), interpolated linearly between the sorted
+// values.
+//
+// writeCSV writes one row per pair; with header set to false, the rows
+// of many subjects are appended to the same table.
+
+#ifndef _volume_LabelStatistics_H
+#define _volume_LabelStatistics_H
+
+#include "ScalarVolume.h"
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <cmath>
+
+namespace volume {
+	
+	using namespace std;
+	
+	struct LabelStatisticsEntry {
+		long count;
+		double mean;
+		double stdev;
+		double min;
+		double max;
+		vector<double> percentiles;
+	};
+	
+	class LabelStatistics {
+		protected:
+		const ScalarVolume& labelVolume;
+		string subject;
+		vector<const ScalarVolume *> volumes;
+		vector<string> names;
+		vector<double> percentiles;
+		
+		// the labels and the voxels of each, as indices (i * ysize + j) * zsize + k
+		vector<int> labels;
+		vector<vector<size_t> > voxels;
+		
+		// results[l][v]: label l, volume v
+		vector<vector<LabelStatisticsEntry> > results;
+		
+		void listVoxels () {
+			int size[3];
+			labelVolume.getSize(size);
+			map<int, vector<size_t> > byLabel;
+			for (int i = 0; i < size[0]; ++i) {
+				for (int j = 0; j < size[1]; ++j) {
+					for (int k = 0; k < size[2]; ++k) {
+						const int label = (int)floor(labelVolume.voxel[i][j][k] + 0.5);
+						if (label != 0) {
+							byLabel[label].push_back(((size_t)i * size[1] + j) * size[2] + k);
+						}
+					}
+				}
+			}
+			labels.clear();
+			voxels.clear();
+			for (map<int, vector<size_t> >::iterator it = byLabel.begin(); it != byLabel.end(); ++it) {
+				labels.push_back(it->first);
+				voxels.push_back(vector<size_t>());
+				voxels.back().swap(it->second);
+			}
+		}
+		
+		void computeEntry (const ScalarVolume& vol, const vector<size_t>& indices, LabelStatisticsEntry& entry) const {
+			int size[3];
+			vol.getSize(size);
+			const size_t plane = (size_t)size[1] * size[2];
+			vector<double> values(indices.size());
+			double sum = 0.0;
+			for (size_t n = 0; n < indices.size(); ++n) {
+				const size_t index = indices[n];
+				values[n] = vol.voxel[index / plane][(index / size[2]) % size[1]][index % size[2]];
+				sum += values[n];
+			}
+			entry.count = values.size();
+			entry.percentiles.assign(percentiles.size(), 0.0);
+			if (values.empty()) {
+				entry.mean = entry.stdev = entry.min = entry.max = 0.0;
+				return;
+			}
+			entry.mean = sum / values.size();
+			double sumSq = 0.0;
+			for (size_t n = 0; n < values.size(); ++n) {
+				sumSq += (values[n] - entry.mean) * (values[n] - entry.mean);
+			}
+			entry.stdev = sqrt(sumSq / values.size());
+			sort(values.begin(), values.end());
+			entry.min = values.front();
+			entry.max = values.back();
+			for (size_t p = 0; p < percentiles.size(); ++p) {
+				const double pos = percentiles[p] / 100.0 * (values.size() - 1);
+				const size_t lower = (size_t)floor(pos);
+				const size_t upper = lower + 1 < values.size() ? lower + 1 : lower;
+				entry.percentiles[p] = values[lower] + (pos - lower) * (values[upper] - values[lower]);
+			}
+		}
+		
+		public:
+		LabelStatistics (const ScalarVolume& in, const string& name = "") : labelVolume(in), subject(name) {
+			const double defaults[5] = {5.0, 25.0, 50.0, 75.0, 95.0};
+			percentiles.assign(defaults, defaults + 5);
+		}
+		
+		// vol must have the size of the label volume
+		void addVolume (const ScalarVolume& vol, const string& name) {
+			int size[3];
+			labelVolume.getSize(size);
+			if (!vol.checkSize(size)) {
+				cerr << "The volume " << name << " must have the size of the label volume" << endl;
+				exit(1);
+			}
+			volumes.push_back(&vol);
+			names.push_back(name);
+		}
+		
+		// in percent, e.g. 50 for the median, each within [0, 100]
+		void setPercentiles (const vector<double>& in) {
+			for (size_t p = 0; p < in.size(); ++p) {
+				if (!(in[p] >= 0.0 && in[p] <= 100.0)) {
+					cerr << "The percentile " << in[p] << " must be within [0, 100]" << endl;
+					exit(1);
+				}
+			}
+			percentiles = in;
+		}
+		
+		void compute () {
+			listVoxels();
+			const int noOfLabels = labels.size();
+			const int noOfVolumes = volumes.size();
+			results.assign(noOfLabels, vector<LabelStatisticsEntry>(noOfVolumes));
+			const int pairs = noOfLabels * noOfVolumes;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+			for (int p = 0; p < pairs; ++p) {
+				const int l = p / noOfVolumes;
+				const int v = p % noOfVolumes;
+				computeEntry(*volumes[v], voxels[l], results[l][v]);
+			}
+		}
+		
+		const vector<int>& getLabels () const {
+			return labels;
+		}
+		
+		const LabelStatisticsEntry& getEntry (const int l, const int v) const {
+			return results[l][v];
+		}
+		
+		void writeCSV (ostream& out, const bool header = true) const {
+			if (header) {
+				out << "subject,label,volume,count,mean,std,min,max";
+				for (size_t p = 0; p < percentiles.size(); ++p) {
+					out << ",p" << percentiles[p];
+				}
+				out << endl;
+			}
+			out << setprecision(10);
+			for (size_t l = 0; l < results.size(); ++l) {
+				for (size_t v = 0; v < results[l].size(); ++v) {
+					const LabelStatisticsEntry& entry = results[l][v];
+					out << subject << ',' << labels[l] << ',' << names[v] << ',' << entry.count << ',';
+					out << entry.mean << ',' << entry.stdev << ',' << entry.min << ',' << entry.max;
+					for (size_t p = 0; p < entry.percentiles.size(); ++p) {
+						out << ',' << entry.percentiles[p];
+					}
+					out << endl;
+				}
+			}
+		}
+		
+		bool writeCSV (const char *filename, const bool header = true) const {
+			ofstream out(filename, header ? ios::out : ios::app);
+			if (!out) {
+				cerr << "Fail to write the label statistics to " << filename << endl;
+				return false;
+			}
+			writeCSV(out, header);
+			return true;
+		}
+	};
+}
+
+#endif
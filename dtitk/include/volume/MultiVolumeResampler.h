@@ -0,0 +1,237 @@
+/*============================================================================
+
+  Program:     DTI ToolKit (DTI-TK)
+  Module:      $RCSfile: MultiVolumeResampler.h,v $
+  Language:    C++
+  Date:        $Date: 2026/10/18 23:05:16 $
+  Version:     $Revision: 1.1 $
+
+  Copyright (c) Gary Hui Zhang (garyhuizhang@gmail.com).
+  All rights reserverd.
+
+  DTI-TK is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  DTI-TK is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with DTI-TK.  If not, see <http://www.gnu.org/licenses/>.
+============================================================================*/
+
+
+// template MultiVolumeResampler<class Transform>
+//
+// declaration and implementation
+//
+// backward resampling of several scalar volumes with one transformation,
+// e.g. an atlas parcellation and a set of ROI masks propagated to a
+// subject.  the transformation is evaluated once per output voxel and
+// the point is sampled from every input, instead of one run of
+// deformationScalarVolume or SVResample per map:
+//
+//   MultiVolumeResampler<DeformationField3D> resampler;
+//   resampler.add(parcellation, subjectParcellation, MultiVolumeResampler<DeformationField3D>::MAJORITY);
+//   resampler.add(roi, subjectROI, MultiVolumeResampler<DeformationField3D>::NEAREST);
+//   resampler.add(fa, subjectFA);
+//   resampler.resample(df);
+//
+// the scalar maps can also be held in float, read with
+// FloatVolume<double>(filename), at half the memory of a ScalarVolume.
+//
+// every input has its own voxel space, the outputs share one: the voxel
+// space of the first output.  each input is sampled with:
+//
+//   TRILINEAR  trilinear interpolation, for scalar maps
+//   NEAREST    the nearest voxel, for labels
+//   MAJORITY   the label with the largest total trilinear weight over the
+//              eight voxels around the point, for labels
+//
+// the points outside an input are given its background.
+//
+// the points are computed first and kept (24 bytes per output voxel),
+// in parallel for the linear transformations only: the others keep the
+// jacobian of the current point in the transformation.  the inputs are
+// then sampled in parallel.  a chain of transformations is composed into
+// one beforehand, e.g. with dfRightComposeAffine.
+
+#ifndef _volume_MultiVolumeResampler_H
+#define _volume_MultiVolumeResampler_H
+
+#include "TransformVolume.h"
+#include "ScalarVolume.h"
+#include "FloatVolume.h"
+#include <iostream>
+#include <vector>
+
+namespace volume {
+	
+	using namespace std;
+	
+	template <class Transform>
+	class MultiVolumeResampler {
+		public:
+		enum Interpolation {TRILINEAR, NEAREST, MAJORITY};
+		
+		protected:
+		vector<const ScalarVolume *> inputs;
+		// the inputs held in float, NULL for the others
+		vector<const FloatVolume<double> *> floatInputs;
+		vector<ScalarVolume *> outputs;
+		vector<Interpolation> modes;
+		
+		// the label with the largest weight over the interpolation cube.
+		// the corners are looked up as in Volume::getVoxelAt, those off
+		// the volume count as the background, which is also returned
+		// for a point outside the volume
+		static double sampleMajority (const ScalarVolume& in, const Vector3D& vec) {
+			int bottomLeft[3];
+			double lambda[3];
+			if (!in.computeBottomLeftCornerIndexAndLambdaRegion(vec, bottomLeft, lambda)) {
+				double bg;
+				in.getBackground(bg);
+				return bg;
+			}
+			int cornerIndex[2][2][2][3];
+			const double *corner[2][2][2];
+			in.computeCornerIndices(bottomLeft, cornerIndex);
+			in.computeCornerObjects(cornerIndex, corner);
+			double labels[8];
+			double weights[8];
+			int count = 0;
+			for (int k = 0; k < 2; ++k) {
+				for (int j = 0; j < 2; ++j) {
+					for (int i = 0; i < 2; ++i) {
+						const double weight = (i ? lambda[0] : 1.0 - lambda[0])
+							* (j ? lambda[1] : 1.0 - lambda[1])
+							* (k ? lambda[2] : 1.0 - lambda[2]);
+						const double label = *corner[k][j][i];
+						int l = 0;
+						while (l < count && labels[l] != label) {
+							++l;
+						}
+						if (l == count) {
+							labels[count] = label;
+							weights[count] = 0.0;
+							++count;
+						}
+						weights[l] += weight;
+					}
+				}
+			}
+			int best = 0;
+			for (int l = 1; l < count; ++l) {
+				if (weights[l] > weights[best]) {
+					best = l;
+				}
+			}
+			return labels[best];
+		}
+		
+		void checkOutput (const string& name, const ScalarVolume& out) const {
+			if (!outputs.empty()) {
+				int size[3];
+				outputs[0]->getSize(size);
+				if (!out.checkSize(size)) {
+					cerr << "The output for " << name << " must have the size of the other outputs" << endl;
+					exit(1);
+				}
+			}
+		}
+		
+		public:
+		// out is the volume the resampled in is written to, in the
+		// voxel space of the outputs
+		void add (const ScalarVolume& in, ScalarVolume& out, const Interpolation mode = TRILINEAR) {
+			checkOutput(in.getName(), out);
+			inputs.push_back(&in);
+			floatInputs.push_back(NULL);
+			outputs.push_back(&out);
+			modes.push_back(mode);
+		}
+		
+		// a scalar map held in float, sampled with TRILINEAR or NEAREST
+		void add (const FloatVolume<double>& in, ScalarVolume& out, const Interpolation mode = TRILINEAR) {
+			if (mode == MAJORITY) {
+				cerr << "MAJORITY sampling is not supported for the float volume " << in.getName() << endl;
+				exit(1);
+			}
+			checkOutput(in.getName(), out);
+			inputs.push_back(NULL);
+			floatInputs.push_back(&in);
+			outputs.push_back(&out);
+			modes.push_back(mode);
+		}
+		
+		int getNoOfVolumes () const {
+			return inputs.size();
+		}
+		
+		// trans maps the output space to the input space, as for
+		// TransformVolume::computeTransformBackward
+		void resample (const Transform& trans) {
+			if (outputs.empty()) {
+				return;
+			}
+			const bool linear = LinearTransformTraits<Transform>::linear;
+			const ScalarVolume& target = *outputs[0];
+			int size[3];
+			target.getSize(size);
+			const int volumes = inputs.size();
+			
+			cout << "resampling " << volumes << " volumes ..." << flush;
+			ScopedTimer timer("MultiVolumeResampler::resample");
+			timer.addVoxels((unsigned long long)size[0] * size[1] * size[2] * volumes);
+			
+			// the points in the input space
+			vector<Vector3D> points((size_t)size[0] * size[1] * size[2]);
+#ifdef _OPENMP
+#pragma omp parallel for if (linear)
+#endif
+			for (int i = 0; i < size[0]; ++i) {
+				for (int j = 0; j < size[1]; ++j) {
+					for (int k = 0; k < size[2]; ++k) {
+						Vector3D& vec = points[((size_t)i * size[1] + j) * size[2] + k];
+						vec[0] = i;
+						vec[1] = j;
+						vec[2] = k;
+						target.toAbs(vec);
+						vec *= trans;
+					}
+				}
+			}
+			
+			// every input at every point
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+			for (int i = 0; i < size[0]; ++i) {
+				for (int j = 0; j < size[1]; ++j) {
+					for (int k = 0; k < size[2]; ++k) {
+						const Vector3D& vec = points[((size_t)i * size[1] + j) * size[2] + k];
+						for (int v = 0; v < volumes; ++v) {
+							double& out = outputs[v]->voxel[i][j][k];
+							// getVoxelAt leaves the background outside
+							const int intp = modes[v] == NEAREST ? 1 : 0;
+							if (modes[v] == MAJORITY) {
+								out = sampleMajority(*inputs[v], vec);
+							} else if (floatInputs[v]) {
+								floatInputs[v]->getVoxelAt(vec, out, intp);
+							} else {
+								inputs[v]->getVoxelAt(vec, out, intp);
+							}
+						}
+					}
+				}
+			}
+			
+			cout << "time consumed = " << timer.elapsed() << endl;
+		}
+	};
+}
+
+#endif
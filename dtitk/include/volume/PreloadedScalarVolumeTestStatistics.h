@@ -0,0 +1,167 @@
+/*============================================================================
+
+  Program:     DTI ToolKit (DTI-TK)
+  Module:      $RCSfile: PreloadedScalarVolumeTestStatistics.h,v $
+  Language:    C++
+  Date:        $Date: 2026/10/18 11:40:05 $
+  Version:     $Revision: 1.1 $
+
+  Copyright (c) Gary Hui Zhang (garyhuizhang@gmail.com).
+  All rights reserverd.
+
+  DTI-TK is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  DTI-TK is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with DTI-TK.  If not, see <http://www.gnu.org/licenses/>.
+============================================================================*/
+
+
+// voxelwise two-sample t-statistics on preloaded data
+//
+// declaration and implementation
+//
+// all the subject values at the hypotheses (in-mask voxels) are read
+// once into a subjects x voxels matrix, with every row contiguous.
+// the per-voxel sums and sums of squares over all the subjects are
+// computed up front, so a permutation only accumulates the rows of
+// group 1; group 2 follows by subtraction.  the inner loops run over
+// contiguous voxels and are written to be auto-vectorized.
+//
+// the values are centered on their voxelwise mean when loaded, which
+// keeps the sum-of-squares variance free of cancellation.
+//
+// the statistic is the pooled-variance Student t of group 1 against
+// group 2.  compute keeps no state in the object and is thread safe.
+
+#ifndef _volume_PreloadedScalarVolumeTestStatistics_h
+#define _volume_PreloadedScalarVolumeTestStatistics_h
+
+#include "VolumeTestStatistics.h"
+#include "ScalarVolume.h"
+#include <vector>
+#include <cmath>
+
+namespace volume {
+	
+	using namespace std;
+	
+	class PreloadedScalarVolumeTestStatistics : public VolumeTestStatistics {
+		protected:
+		// number of hypotheses rounded up to a multiple of 4 so
+		// that every row starts aligned for the vector units
+		int stride;
+		
+		// subjects x voxels, row s at data[s * stride]
+		vector<double> data;
+		
+		// sums and sums of squares over all the subjects
+		vector<double> totalSum;
+		vector<double> totalSumSq;
+		
+		void preload (const char *mask) {
+			const int N = noOfObservations;
+			const int H = noOfHypotheses;
+			int sz[3];
+			ScalarVolume(mask).getSize(sz);
+			stride = (H + 3) / 4 * 4;
+			data.assign((size_t)N * stride, 0.0);
+			
+			for (int s = 0; s < N; ++s) {
+				ScalarVolume sv(files[s].c_str());
+				if (!sv.checkSize(sz)) {
+					cerr << files[s] << " does not match the size of the mask" << endl;
+					exit(1);
+				}
+				double *row = &data[(size_t)s * stride];
+				for (int h = 0; h < H; ++h) {
+					const vector<int>& idx = hypothesesIndex[h];
+					row[h] = sv.voxel[idx[0]][idx[1]][idx[2]];
+				}
+			}
+			
+			// center each voxel on its mean over all the subjects
+			vector<double> mean(stride, 0.0);
+			for (int s = 0; s < N; ++s) {
+				const double *row = &data[(size_t)s * stride];
+				for (int h = 0; h < stride; ++h) {
+					mean[h] += row[h];
+				}
+			}
+			for (int h = 0; h < stride; ++h) {
+				mean[h] /= N;
+			}
+			totalSum.assign(stride, 0.0);
+			totalSumSq.assign(stride, 0.0);
+			for (int s = 0; s < N; ++s) {
+				double *row = &data[(size_t)s * stride];
+				for (int h = 0; h < stride; ++h) {
+					row[h] -= mean[h];
+					totalSum[h] += row[h];
+					totalSumSq[h] += row[h] * row[h];
+				}
+			}
+		}
+		
+		public:
+		PreloadedScalarVolumeTestStatistics (const char *group1, const char *group2, const char *mask)
+			: VolumeTestStatistics(group1, group2, mask) {
+			cout << "Preloading " << noOfObservations << " subjects at ";
+			cout << noOfHypotheses << " voxels" << endl;
+			preload(mask);
+		}
+		
+		~PreloadedScalarVolumeTestStatistics () {};
+		
+		bool isThreadSafe () const {
+			return true;
+		}
+		
+		void compute (const vector<int>& permutation, vector<double>& testStats) {
+			const int H = noOfHypotheses;
+			const int n1 = noOfGroup1Observations;
+			const int n2 = noOfObservations - n1;
+			
+			// group 1 partial sums: a streaming pass over its rows
+			vector<double> sum1(stride, 0.0);
+			vector<double> sumSq1(stride, 0.0);
+			double *s1 = &sum1[0];
+			double *q1 = &sumSq1[0];
+			for (int s = 0; s < n1; ++s) {
+				const double *row = &data[(size_t)permutation[s] * stride];
+				for (int h = 0; h < stride; ++h) {
+					s1[h] += row[h];
+					q1[h] += row[h] * row[h];
+				}
+			}
+			
+			const double *s = &totalSum[0];
+			const double *q = &totalSumSq[0];
+			const double inv1 = 1.0 / n1;
+			const double inv2 = 1.0 / n2;
+			const double dof = 1.0 / (n1 + n2 - 2);
+			testStats.resize(H);
+			double *t = &testStats[0];
+			for (int h = 0; h < H; ++h) {
+				const double s2 = s[h] - s1[h];
+				const double q2 = q[h] - q1[h];
+				const double m1 = s1[h] * inv1;
+				const double m2 = s2 * inv2;
+				// pooled variance from the sums of squares
+				double pooled = q1[h] - s1[h] * m1 + q2 - s2 * m2;
+				pooled *= dof;
+				const double se = pooled * (inv1 + inv2);
+				t[h] = se > 0.0 ? (m1 - m2) / std::sqrt(se) : 0.0;
+			}
+		}
+	};
+}
+
+#endif
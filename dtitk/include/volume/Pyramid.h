@@ -0,0 +1,273 @@
+/*============================================================================
+
+  Program:     DTI ToolKit (DTI-TK)
+  Module:      $RCSfile: Pyramid.h,v $
+  Language:    C++
+  Date:        $Date: 2026/10/18 15:52:07 $
+  Version:     $Revision: 1.1 $
+
+  Copyright (c) Gary Hui Zhang (garyhuizhang@gmail.com).
+  All rights reserverd.
+
+  DTI-TK is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  DTI-TK is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with DTI-TK.  If not, see <http://www.gnu.org/licenses/>.
+============================================================================*/
+
+
+// template Pyramid<class VolumeType>
+//
+// declaration and implementation
+//
+// coarse-to-fine image pyramid shared by the registration levels.
+// every level is given by its sampling separation in mm, as for the
+// -sep options of the registration tools.  a level is the source
+// smoothed with the sigma from VoxelSpace::computeSigma and resampled
+// onto a grid with the separation as its voxel size, so the coarse
+// levels are iterated at their own size instead of stepping through
+// the full resolution grid.  levels at or below the source voxel size
+// are the source itself.
+//
+// the levels are cached to disk, keyed by a hash of the content of the
+// source file and the separation, so a volume registered repeatedly
+// (e.g. a subject across the iterations of the population scripts, or
+// the template across all the subjects) is only smoothed and
+// downsampled once.  the gradients are not cached; they are rebuilt on
+// loading when enabled.  a level is written under a name of its own to
+// the process and renamed into place, so the jobs sharing a cache never
+// read a level still being written.
+//
+// VolumeType is expected to be SymTensor3DVolume or ScalarVolume
+// (anything constructible from a filename or a size and providing
+// writeVolAs, gaussianSmoothing and computeTransform).
+
+#ifndef _volume_Pyramid_H
+#define _volume_Pyramid_H
+
+#include "VoxelSpace.h"
+#include "../io/Profiler.h"
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <cstdio>
+#include <unistd.h>
+
+namespace volume {
+	
+	using namespace std;
+	using io::ScopedTimer;
+	
+	template <class VolumeType>
+	class Pyramid {
+		protected:
+		string source;
+		
+		// empty if the levels are not cached
+		string cacheDir;
+		
+		// the separation of every level, in mm
+		vector< vector<double> > seps;
+		
+		vector<VolumeType *> levels;
+		
+		bool gradEnabled;
+		
+		// whether a level is the source rather than a copy
+		bool isSource (const vector<double>& sep, const double vsize[3]) const {
+			for (int m = 0; m < 3; ++m) {
+				if (sep[m] > vsize[m]) {
+					return false;
+				}
+			}
+			return true;
+		}
+		
+		string getCacheFilename (const string& hash, const vector<double>& sep) const {
+			// strip the directory and the extension of the source
+			string base = source;
+			const size_t slash = base.rfind('/');
+			if (slash != string::npos) {
+				base = base.substr(slash + 1);
+			}
+			const size_t dot = base.find('.');
+			if (dot != string::npos) {
+				base = base.substr(0, dot);
+			}
+			ostringstream oss;
+			oss << cacheDir << '/' << base << '_' << hash;
+			oss << '_' << sep[0] << 'x' << sep[1] << 'x' << sep[2] << ".nii.gz";
+			return oss.str();
+		}
+		
+		// write a level to the cache, atomically
+		void writeCache (VolumeType& level, const string& cached) const {
+			ostringstream oss;
+			oss << cached.substr(0, cached.size() - 7) << '.' << getpid() << ".tmp.nii.gz";
+			const string tmp = oss.str();
+			if (!level.writeVolAs(tmp.c_str()) || rename(tmp.c_str(), cached.c_str()) != 0) {
+				cerr << "Fail to cache the level " << cached << endl;
+				remove(tmp.c_str());
+			}
+		}
+		
+		// smooth and downsample the source for the separation
+		VolumeType *computeLevel (const VolumeType& src, const vector<double>& sep) const {
+			int sz[3];
+			double vsz[3];
+			double org[3];
+			src.getSize(sz);
+			src.getVSize(vsz);
+			src.getOrigin(org);
+			
+			VolumeType smoothed(sz);
+			smoothed.setVSize(vsz);
+			smoothed.setOrigin(org);
+			smoothed = src;
+			double sigma[3];
+			smoothed.computeSigma(&sep[0], sigma);
+			smoothed.gaussianSmoothing(sigma);
+			
+			int outSize[3];
+			VoxelSpace::computeSize(sz, vsz, &sep[0], outSize);
+			VolumeType *level = new VolumeType(outSize);
+			level->setVSize(&sep[0]);
+			level->setOrigin(org);
+			smoothed.computeTransform(*level);
+			return level;
+		}
+		
+		void clear () {
+			for (size_t l = 0; l < levels.size(); ++l) {
+				if (levels[l] != NULL) {
+					delete levels[l];
+				}
+			}
+			levels.clear();
+		}
+		
+		public:
+		Pyramid (const char *filename) : source(filename) {
+			gradEnabled = false;
+		}
+		
+		~Pyramid () {
+			clear();
+		}
+		
+		// where the levels are cached; an empty string disables it
+		void setCacheDirectory (const char *dir) {
+			cacheDir = dir;
+		}
+		
+		void setGradientEnabled (const bool in) {
+			gradEnabled = in;
+		}
+		
+		// add a level with the given separation in mm
+		// the levels are kept in the order they are added
+		void addLevel (const double sep[3]) {
+			seps.push_back(vector<double>(sep, sep + 3));
+		}
+		
+		int getNoOfLevels () const {
+			return seps.size();
+		}
+		
+		VolumeType& getLevel (const int l) {
+			if (l < 0 || l >= (int)levels.size() || levels[l] == NULL) {
+				cerr << "Pyramid level " << l << " of " << source << " is not built" << endl;
+				exit(1);
+			}
+			return *levels[l];
+		}
+		
+		// 64-bit FNV-1a hash of the content of the file, in hex
+		static string computeHash (const char *filename) {
+			ifstream in(filename, ios::in | ios::binary);
+			if (!in) {
+				cerr << "Fail to read " << filename << endl;
+				exit(1);
+			}
+			unsigned long long hash = 0xcbf29ce484222325ULL;
+			char buffer[65536];
+			while (in) {
+				in.read(buffer, sizeof(buffer));
+				const streamsize n = in.gcount();
+				for (streamsize i = 0; i < n; ++i) {
+					hash ^= (unsigned char)buffer[i];
+					hash *= 0x100000001b3ULL;
+				}
+			}
+			ostringstream oss;
+			oss << hex << setw(16) << setfill('0') << hash;
+			return oss.str();
+		}
+		
+		// build all the levels, from the cache where possible
+		void build () {
+			cout << "Building the pyramid of " << source << " ... " << endl;
+			ScopedTimer timer("Pyramid::build");
+			clear();
+			
+			const string hash = cacheDir.size() > 0 ? computeHash(source.c_str()) : string();
+			VolumeType *src = NULL;
+			levels.assign(seps.size(), (VolumeType *)NULL);
+			for (size_t l = 0; l < seps.size(); ++l) {
+				string cached;
+				if (cacheDir.size() > 0) {
+					cached = getCacheFilename(hash, seps[l]);
+					ifstream test(cached.c_str());
+					if (test) {
+						test.close();
+						cout << "level " << l << " from the cache " << cached << endl;
+						levels[l] = new VolumeType(cached.c_str());
+					}
+				}
+				
+				if (levels[l] == NULL) {
+					if (src == NULL) {
+						src = new VolumeType(source.c_str());
+					}
+					double vsz[3];
+					src->getVSize(vsz);
+					if (isSource(seps[l], vsz)) {
+						// hand over the source, it is reloaded if
+						// a later level needs it
+						levels[l] = src;
+						src = NULL;
+					} else {
+						levels[l] = computeLevel(*src, seps[l]);
+						if (cached.size() > 0) {
+							writeCache(*levels[l], cached);
+						}
+					}
+				}
+				
+				levels[l]->setName(source);
+				if (gradEnabled) {
+					levels[l]->buildGradient();
+				}
+			}
+			if (src != NULL) {
+				delete src;
+			}
+			
+			cout << "Pyramid done in " << timer.elapsed() << 's' << endl;
+		}
+	};
+}
+
+#endif
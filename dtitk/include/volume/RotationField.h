@@ -0,0 +1,243 @@
+/*============================================================================
+
+  Program:     DTI ToolKit (DTI-TK)
+  Module:      $RCSfile: RotationField.h,v $
+  Language:    C++
+  Date:        $Date: 2026/10/18 21:47:33 $
+  Version:     $Revision: 1.1 $
+
+  Copyright (c) Gary Hui Zhang (garyhuizhang@gmail.com).
+  All rights reserverd.
+
+  DTI-TK is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  DTI-TK is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with DTI-TK.  If not, see <http://www.gnu.org/licenses/>.
+============================================================================*/
+
+
+// class RotationField
+//
+// declaration and implementation
+//
+// the finite strain (FS) reorientation of a deformation field, computed
+// once per voxel of the field and kept as unit quaternions in floats
+// (16 bytes per voxel).  warping several volumes, or the same volume
+// again, with the same field reads the rotations back instead of
+// computing the jacobian and its polar decomposition at every voxel:
+//
+//   RotationField rotation(df);
+//   rotation.write("subject_diffeo.rot");
+//   subject.computeTransformWith(rotation, out);
+//
+// the field is a displacement, so its jacobian J is the identity plus the
+// gradient of the displacement (see JacobianField).  the resampling is
+// backward, so the tensors are reoriented by the rotation of the inverse
+// of J, that is the transpose of the rotation R of J = RS.  the stored
+// rotation is that transpose.
+//
+// the file written by write is the size, the voxel size and the origin
+// of the field followed by the quaternions (w, x, y, z) in the byte
+// order of the machine.  matches tells whether a rotation field was
+// built from a deformation field of a given voxel space.
+
+#ifndef _volume_RotationField_H
+#define _volume_RotationField_H
+
+#include "JacobianField.h"
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <cmath>
+
+namespace volume {
+	
+	using namespace std;
+	
+	class RotationField {
+		protected:
+		int size[3];
+		double vsize[3];
+		double origin[3];
+		vector<float> quaternions;
+		
+		size_t getIndex (const int i, const int j, const int k) const {
+			return (((size_t)i * size[1] + j) * size[2] + k) * 4;
+		}
+		
+		public:
+		RotationField () {
+			for (int m = 0; m < 3; ++m) {
+				size[m] = 0;
+				vsize[m] = 0.0;
+				origin[m] = 0.0;
+			}
+		}
+		
+		explicit RotationField (const DeformationField3D& df) {
+			build(df);
+		}
+		
+		// the unit quaternion of a rotation matrix
+		static void toQuaternion (const double r[3][3], float q[4]) {
+			double w, x, y, z;
+			const double trace = r[0][0] + r[1][1] + r[2][2];
+			if (trace > 0.0) {
+				const double s = 2.0 * sqrt(trace + 1.0);
+				w = 0.25 * s;
+				x = (r[2][1] - r[1][2]) / s;
+				y = (r[0][2] - r[2][0]) / s;
+				z = (r[1][0] - r[0][1]) / s;
+			} else if (r[0][0] > r[1][1] && r[0][0] > r[2][2]) {
+				const double s = 2.0 * sqrt(1.0 + r[0][0] - r[1][1] - r[2][2]);
+				w = (r[2][1] - r[1][2]) / s;
+				x = 0.25 * s;
+				y = (r[0][1] + r[1][0]) / s;
+				z = (r[0][2] + r[2][0]) / s;
+			} else if (r[1][1] > r[2][2]) {
+				const double s = 2.0 * sqrt(1.0 + r[1][1] - r[0][0] - r[2][2]);
+				w = (r[0][2] - r[2][0]) / s;
+				x = (r[0][1] + r[1][0]) / s;
+				y = 0.25 * s;
+				z = (r[1][2] + r[2][1]) / s;
+			} else {
+				const double s = 2.0 * sqrt(1.0 + r[2][2] - r[0][0] - r[1][1]);
+				w = (r[1][0] - r[0][1]) / s;
+				x = (r[0][2] + r[2][0]) / s;
+				y = (r[1][2] + r[2][1]) / s;
+				z = 0.25 * s;
+			}
+			const double norm = sqrt(w * w + x * x + y * y + z * z);
+			q[0] = (float)(w / norm);
+			q[1] = (float)(x / norm);
+			q[2] = (float)(y / norm);
+			q[3] = (float)(z / norm);
+		}
+		
+		// the rotation matrix of a unit quaternion
+		static void toMatrix (const float q[4], double r[3][3]) {
+			const double w = q[0], x = q[1], y = q[2], z = q[3];
+			r[0][0] = 1.0 - 2.0 * (y * y + z * z);
+			r[0][1] = 2.0 * (x * y - z * w);
+			r[0][2] = 2.0 * (x * z + y * w);
+			r[1][0] = 2.0 * (x * y + z * w);
+			r[1][1] = 1.0 - 2.0 * (x * x + z * z);
+			r[1][2] = 2.0 * (y * z - x * w);
+			r[2][0] = 2.0 * (x * z - y * w);
+			r[2][1] = 2.0 * (y * z + x * w);
+			r[2][2] = 1.0 - 2.0 * (x * x + y * y);
+		}
+		
+		// a folding (non-positive jacobian determinant) has no rotation
+		// and is given the identity
+		void build (const DeformationField3D& df) {
+			df.getSize(size);
+			df.getVSize(vsize);
+			df.getOrigin(origin);
+			quaternions.assign((size_t)size[0] * size[1] * size[2] * 4, 0.0f);
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+			for (int i = 0; i < size[0]; ++i) {
+				double jac[3][3];
+				double r[3][3];
+				for (int j = 0; j < size[1]; ++j) {
+					for (int k = 0; k < size[2]; ++k) {
+						float *q = &quaternions[getIndex(i, j, k)];
+						JacobianField::computeAt(df, size, vsize, i, j, k, jac);
+						if (JacobianField::det(jac) <= 0.0) {
+							q[0] = 1.0f;
+							continue;
+						}
+						Matrix3D orthogonal, spd;
+						Matrix3D(jac).toPolarDecomposition(orthogonal, spd);
+						for (int m = 0; m < 3; ++m) {
+							for (int n = 0; n < 3; ++n) {
+								r[m][n] = orthogonal.getElement(n, m);
+							}
+						}
+						toQuaternion(r, q);
+					}
+				}
+			}
+		}
+		
+		void getSize (int sz[3]) const {
+			for (int m = 0; m < 3; ++m) {
+				sz[m] = size[m];
+			}
+		}
+		
+		bool checkSize (const int sz[3]) const {
+			return sz[0] == size[0] && sz[1] == size[1] && sz[2] == size[2];
+		}
+		
+		// same size, voxel size and origin as vs
+		bool matches (const VoxelSpace& vs) const {
+			int sz[3];
+			double vsz[3];
+			double org[3];
+			vs.getSize(sz);
+			vs.getVSize(vsz);
+			vs.getOrigin(org);
+			if (!checkSize(sz)) {
+				return false;
+			}
+			for (int m = 0; m < 3; ++m) {
+				if (fabs(vsz[m] - vsize[m]) > 1e-6 || fabs(org[m] - origin[m]) > 1e-6) {
+					return false;
+				}
+			}
+			return true;
+		}
+		
+		void getRotation (const int i, const int j, const int k, Matrix3D& rot) const {
+			double r[3][3];
+			toMatrix(&quaternions[getIndex(i, j, k)], r);
+			rot.setMatrix(r);
+		}
+		
+		bool write (const char *filename) const {
+			ofstream out(filename, ios::binary);
+			if (!out) {
+				cerr << "Fail to write the rotation field " << filename << endl;
+				return false;
+			}
+			out.write((const char *)size, sizeof(size));
+			out.write((const char *)vsize, sizeof(vsize));
+			out.write((const char *)origin, sizeof(origin));
+			out.write((const char *)&quaternions[0], quaternions.size() * sizeof(float));
+			return out.good();
+		}
+		
+		bool read (const char *filename) {
+			ifstream in(filename, ios::binary);
+			if (!in || !in.read((char *)size, sizeof(size)) || !in.read((char *)vsize, sizeof(vsize)) || !in.read((char *)origin, sizeof(origin))) {
+				cerr << "Fail to read the rotation field " << filename << endl;
+				return false;
+			}
+			if (size[0] <= 0 || size[1] <= 0 || size[2] <= 0) {
+				cerr << "Invalid size " << size[0] << 'x' << size[1] << 'x' << size[2];
+				cerr << " in the rotation field " << filename << endl;
+				size[0] = size[1] = size[2] = 0;
+				return false;
+			}
+			quaternions.resize((size_t)size[0] * size[1] * size[2] * 4);
+			if (!in.read((char *)&quaternions[0], quaternions.size() * sizeof(float))) {
+				cerr << "Fail to read the rotation field " << filename << endl;
+				return false;
+			}
+			return true;
+		}
+	};
+}
+
+#endif
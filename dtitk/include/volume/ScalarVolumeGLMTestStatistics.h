@@ -0,0 +1,126 @@
+/*============================================================================
+
+  Program:     DTI ToolKit (DTI-TK)
+  Module:      $RCSfile: ScalarVolumeGLMTestStatistics.h,v $
+  Language:    C++
+  Date:        $Date: 2026/10/18 12:58:09 $
+  Version:     $Revision: 1.1 $
+
+  Copyright (c) Gary Hui Zhang (garyhuizhang@gmail.com).
+  All rights reserverd.
+
+  DTI-TK is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  DTI-TK is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with DTI-TK.  If not, see <http://www.gnu.org/licenses/>.
+============================================================================*/
+
+
+// voxelwise GLM t-statistics on scalar volumes
+//
+// declaration and implementation
+//
+// the subjects are given as a file list in the order of the rows of
+// the design matrix; the hypotheses are the voxels in the mask.
+
+#ifndef _volume_ScalarVolumeGLMTestStatistics_h
+#define _volume_ScalarVolumeGLMTestStatistics_h
+
+#include "../numerics/GLMTestStatistics.h"
+#include "ScalarVolume.h"
+#include "../io/util.h"
+#include <vector>
+#include <string>
+
+namespace volume {
+	
+	using namespace std;
+	using namespace numerics;
+	
+	class ScalarVolumeGLMTestStatistics : public GLMTestStatistics {
+		protected:
+		vector<string> files;
+		vector< vector<int> > hypothesesIndex;
+		string maskFile;
+		
+		public:
+		ScalarVolumeGLMTestStatistics (const char *subjects, const char *designFile, const char *contrastFile, const char *mask)
+			: GLMTestStatistics(designFile, contrastFile), maskFile(mask) {
+			io::parseFileList(subjects, files);
+			if ((int)files.size() != noOfObservations) {
+				cerr << "The design has " << noOfObservations << " rows but ";
+				cerr << files.size() << " subjects are listed in " << subjects << endl;
+				exit(1);
+			}
+			
+			ScalarVolume mv(mask);
+			int sz[3];
+			mv.getSize(sz);
+			for (int i = 0; i < sz[0]; ++i) {
+				for (int j = 0; j < sz[1]; ++j) {
+					for (int k = 0; k < sz[2]; ++k) {
+						if ((int)(mv.voxel[i][j][k]) != 0) {
+							vector<int> idx(3);
+							idx[0] = i;
+							idx[1] = j;
+							idx[2] = k;
+							hypothesesIndex.push_back(idx);
+						}
+					}
+				}
+			}
+			
+			const int H = hypothesesIndex.size();
+			cout << "Preloading " << noOfObservations << " subjects at ";
+			cout << H << " voxels" << endl;
+			vector<double> values((size_t)noOfObservations * H);
+			for (int s = 0; s < noOfObservations; ++s) {
+				ScalarVolume sv(files[s].c_str());
+				if (!sv.checkSize(sz)) {
+					cerr << files[s] << " does not match the size of the mask" << endl;
+					exit(1);
+				}
+				for (int h = 0; h < H; ++h) {
+					const vector<int>& idx = hypothesesIndex[h];
+					values[(size_t)s * H + h] = sv.voxel[idx[0]][idx[1]][idx[2]];
+				}
+			}
+			setData(values, H);
+		}
+		
+		~ScalarVolumeGLMTestStatistics () {};
+		
+		const vector< vector<int> >& getHypothesesIndex () const {
+			return hypothesesIndex;
+		}
+		
+		// write the statistics into a volume in the space of the mask
+		void mapTestStatisticsToVolume (const char *output, const vector<double>& testStats) const {
+			ScalarVolume sv(maskFile.c_str());
+			int sz[3];
+			sv.getSize(sz);
+			for (int i = 0; i < sz[0]; ++i) {
+				for (int j = 0; j < sz[1]; ++j) {
+					for (int k = 0; k < sz[2]; ++k) {
+						sv.voxel[i][j][k] = 0.0;
+					}
+				}
+			}
+			for (size_t h = 0; h < hypothesesIndex.size(); ++h) {
+				const vector<int>& idx = hypothesesIndex[h];
+				sv.voxel[idx[0]][idx[1]][idx[2]] = testStats[h];
+			}
+			sv.writeVolAs(output);
+		}
+	};
+}
+
+#endif
@@ -225,8 +225,9 @@ namespace volume {
 		
 		void isNaN () const {
 			cout << "Identifying NaN voxels in " << this->name << " ... " << flush;
-			clock_t t1 = clock();
+			ScopedTimer timer("TransformSymTensor3DVolume::isNaN");
 			_SIZE
+			timer.addVoxels((unsigned long long)xsize * ysize * zsize);
 			// to record the NaN voxels
 			ScalarVolume sv(this->size);
 			sv.setVSize(this->vsize);
@@ -240,8 +241,7 @@ namespace volume {
 					sv.voxel[i][j][k] = 0.0;
 				}
 			_ITERATE_END
-			clock_t t2 = clock();
-			cout << "Done in " << (t2 - t1)/(double)CLOCKS_PER_SEC << 's' << endl;
+			cout << "Done in " << timer.elapsed() << 's' << endl;
 			sv.setName(getFilenameForSymTensor3DVolumeDerived(this->name.c_str(),"NaN"));
 			sv.writeVol();
 			cout << "NaN tensors count = " << count << endl;
@@ -267,8 +267,9 @@ namespace volume {
 		void spd () {
 			cout << "Converting " << this->name;
 			cout << " to be symmetric positive definite ... " << flush;
-			clock_t t1 = clock();
+			ScopedTimer timer("TransformSymTensor3DVolume::spd");
 			_SIZE
+			timer.addVoxels((unsigned long long)xsize * ysize * zsize);
 			// to record the non-spd voxels
 			ScalarVolume sv(this->size);
 			sv.setVSize(this->vsize);
@@ -284,8 +285,7 @@ namespace volume {
 					sv.voxel[i][j][k] = 0.0;
 				}
 			_ITERATE_END
-			clock_t t2 = clock();
-			cout << "Done in " << (t2 - t1)/(double)CLOCKS_PER_SEC << 's' << endl;
+			cout << "Done in " << timer.elapsed() << 's' << endl;
 			sv.setName(getFilenameForSymTensor3DVolumeDerived(this->name.c_str(),"nonSPD"));
 			sv.writeVol();
 			this->setName(getFilenameForSymTensor3DVolumeDerived(this->name.c_str(), "spd"));
@@ -297,13 +297,13 @@ namespace volume {
 			cout << "Converting " << this->name;
 			cout << " to dyadic of eigenvector " << index + 1;
 			cout << " ... " << flush;
-			clock_t t1 = clock();
+			ScopedTimer timer("TransformSymTensor3DVolume::dyadic");
 			_SIZE
+			timer.addVoxels((unsigned long long)xsize * ysize * zsize);
 			_ITERATE_BEGIN
 				this->voxel[i][j][k].toDyadicTensor(index);
 			_ITERATE_END
-			clock_t t2 = clock();
-			cout << "Done in " << (t2 - t1)/(double)CLOCKS_PER_SEC << 's' << endl;
+			cout << "Done in " << timer.elapsed() << 's' << endl;
 			this->setName(getFilenameForSymTensor3DVolumeDerived(this->name.c_str(), "dyadic"));
 			return;
 		}
@@ -311,13 +311,13 @@ namespace volume {
 		void deviatoric () {
 			cout << "Converting " << this->name;
 			cout << " to deviatoric tensors ... " << flush;
-			clock_t t1 = clock();
+			ScopedTimer timer("TransformSymTensor3DVolume::deviatoric");
 			_SIZE
+			timer.addVoxels((unsigned long long)xsize * ysize * zsize);
 			_ITERATE_BEGIN
 				this->voxel[i][j][k].convertToDeviatoric();
 			_ITERATE_END
-			clock_t t2 = clock();
-			cout << "Done in " << (t2 - t1)/(double)CLOCKS_PER_SEC << 's' << endl;
+			cout << "Done in " << timer.elapsed() << 's' << endl;
 			this->setName(getFilenameForSymTensor3DVolumeDerived(this->name.c_str(), "dev"));
 			return;
 		}
@@ -333,8 +333,9 @@ namespace volume {
 		void maskBy (const Volume<double>& mask, double mean = 0.0, double stdev = 0.0) {
 			cout << "Masking " << this->name << " by ";
 			cout << mask.getName() << " ... " << flush;
-			clock_t t1 = clock();
+			ScopedTimer timer("TransformSymTensor3DVolume::maskBy");
 			_SIZE
+			timer.addVoxels((unsigned long long)xsize * ysize * zsize);
 			_ITERATE_BEGIN
 				if (mask.voxel[i][j][k] == 0) {
 					if (mean > 0.0) {
@@ -349,8 +350,7 @@ namespace volume {
 					}
 				}
 			_ITERATE_END
-			clock_t t2 = clock();
-			cout << "Done in " << (t2 - t1)/(double)CLOCKS_PER_SEC << 's' << endl;
+			cout << "Done in " << timer.elapsed() << 's' << endl;
 			this->setName(getFilenameForSymTensor3DVolumeDerived(this->name.c_str(), "masked"));
 			return;
 		}
@@ -409,13 +409,13 @@ namespace volume {
 		
 		void reorient (const Matrix3D& mat) {
 			cout << "Reorienting " << this->name << " ... " << flush;
-			clock_t t1 = clock();
+			ScopedTimer timer("TransformSymTensor3DVolume::reorient");
 			_SIZE
+			timer.addVoxels((unsigned long long)xsize * ysize * zsize);
 			_ITERATE_BEGIN
 				this->voxel[i][j][k].PPDTransformByEqual(mat);
 			_ITERATE_END
-			clock_t t2 = clock();
-			cout << "Done in " << (t2 - t1)/(double)CLOCKS_PER_SEC << 's' << endl;
+			cout << "Done in " << timer.elapsed() << 's' << endl;
 			this->setName(getFilenameForSymTensor3DVolumeDerived(this->name.c_str(), "reorient"));
 			return;
 		}
@@ -475,7 +475,7 @@ namespace volume {
 						break;
 			}
 			cout << "map ... " << flush;
-			clock_t t1 = clock();
+			ScopedTimer timer("TransformSymTensor3DVolume::getScalarIndex");
 			_ITERATE_BEGIN
 				double tmp = 0.0;
 				switch (type) {
@@ -515,8 +515,7 @@ namespace volume {
 				}
 				sVol[i][j][k] = tmp;
 			_ITERATE_END
-			clock_t t2 = clock();
-			cout << "Done in " << (t2 - t1)/(double)CLOCKS_PER_SEC << 's' << endl;
+			cout << "Done in " << timer.elapsed() << 's' << endl;
 			sv->setName(getFilenameForSymTensor3DVolumeDerived(this->name.c_str(), suffix.c_str()));
 			return sv;
 		}
@@ -524,8 +523,9 @@ namespace volume {
 		ScalarVolume *getVoxelwiseSimilarityTo (const Volume<SymTensor3D>& in) const {
 			cout << "Computing voxelwise similarity to " << in.getName();
 			cout << "  ... " << flush;
-			clock_t t1 = clock();
+			ScopedTimer timer("TransformSymTensor3DVolume::getVoxelwiseSimilarityTo");
 			_SIZE
+			timer.addVoxels((unsigned long long)xsize * ysize * zsize);
 			ScalarVolume *sv = new ScalarVolume(this->size);
 			sv->setVSize(this->vsize);
 			sv->setOrigin(this->origin);
@@ -535,8 +535,7 @@ namespace volume {
 				tmp = this->voxel[i][j][k].computeSimilarity(in.voxel[i][j][k]);
 				sVol[i][j][k] = tmp;
 			_ITERATE_END
-			clock_t t2 = clock();
-			cout << "Done in " << (t2 - t1)/(double)CLOCKS_PER_SEC << 's' << endl;
+			cout << "Done in " << timer.elapsed() << 's' << endl;
 			sv->setName(getFilenameForSymTensor3DVolumeDerived(this->name.c_str(),"sm"));
 			return sv;
 		}
@@ -545,8 +544,9 @@ namespace volume {
 			cout << "Computing the angle of PD map to ";
 			cout << in.getName() << " in the mask " << mask.getName();
 			cout << " ... " << flush;
-			clock_t t1 = clock();
+			ScopedTimer timer("TransformSymTensor3DVolume::getAngleOfPDs");
 			_SIZE
+			timer.addVoxels((unsigned long long)xsize * ysize * zsize);
 			ScalarVolume *sv = new ScalarVolume(this->size);
 			sv->setVSize(this->vsize);
 			sv->setOrigin(this->origin);
@@ -560,8 +560,7 @@ namespace volume {
 					sVol[i][j][k] = 0.0;
 				}
 			_ITERATE_END
-			clock_t t2 = clock();
-			cout << "Done in " << (t2 - t1)/(double)CLOCKS_PER_SEC << 's' << endl;
+			cout << "Done in " << timer.elapsed() << 's' << endl;
 			sv->setName(getFilenameForSymTensor3DVolumeDerived(this->name.c_str(), "aop"));
 			return sv;
 		}
@@ -590,8 +589,9 @@ namespace volume {
 		
 		void getEigenvalues (ScalarVolume *eigsSV[3]) const {
 			cout << "Computing the tensor eigenvalue maps ... " << flush;
-			clock_t t1 = clock();
+			ScopedTimer timer("TransformSymTensor3DVolume::getEigenvalues");
 			_SIZE
+			timer.addVoxels((unsigned long long)xsize * ysize * zsize);
 			for (int m = 0; m < 3; ++m) {
 				eigsSV[m] = new ScalarVolume(this->size);
 				eigsSV[m]->setVSize(this->vsize);
@@ -605,8 +605,7 @@ namespace volume {
 					eigsSV[m]->voxel[i][j][k] = eigs[m];
 				}
 			_ITERATE_END
-			clock_t t2 = clock();
-			cout << "Done in " << (t2 - t1)/(double)CLOCKS_PER_SEC << 's' << endl;
+			cout << "Done in " << timer.elapsed() << 's' << endl;
 			eigsSV[0]->setName(getFilenameForSymTensor3DVolumeDerived(this->name.c_str(), "lambda1"));
 			eigsSV[1]->setName(getFilenameForSymTensor3DVolumeDerived(this->name.c_str(), "lambda2"));
 			eigsSV[2]->setName(getFilenameForSymTensor3DVolumeDerived(this->name.c_str(), "lambda3"));
@@ -614,8 +613,9 @@ namespace volume {
 		
 		void getLPSMeasures (ScalarVolume *lps[3]) const {
 			cout << "Computing the tensor shape index maps ... " << flush;
-			clock_t t1 = clock();
+			ScopedTimer timer("TransformSymTensor3DVolume::getLPSMeasures");
 			_SIZE
+			timer.addVoxels((unsigned long long)xsize * ysize * zsize);
 			for (int m = 0; m < 3; ++m) {
 				lps[m] = new ScalarVolume(this->size);
 				lps[m]->setVSize(this->vsize);
@@ -629,8 +629,7 @@ namespace volume {
 					lps[m]->voxel[i][j][k] = tmp[m];
 				}
 			_ITERATE_END
-			clock_t t2 = clock();
-			cout << "Done in " << (t2 - t1)/(double)CLOCKS_PER_SEC << 's' << endl;
+			cout << "Done in " << timer.elapsed() << 's' << endl;
 			lps[0]->setName(getFilenameForSymTensor3DVolumeDerived(this->name.c_str(), "linear"));
 			lps[1]->setName(getFilenameForSymTensor3DVolumeDerived(this->name.c_str(), "planar"));
 			lps[2]->setName(getFilenameForSymTensor3DVolumeDerived(this->name.c_str(), "spherical"));
@@ -642,8 +641,9 @@ namespace volume {
 			} else {
 				cout << "Computing the principal diffusion direction map ... " << flush;
 			}
-			clock_t t1 = clock();
+			ScopedTimer timer("TransformSymTensor3DVolume::getPD");
 			_SIZE
+			timer.addVoxels((unsigned long long)xsize * ysize * zsize);
 			Vector3DVolume *vv = new Vector3DVolume(this->size);
 			vv->setOrigin(this->origin);
 			vv->setVSize(this->vsize);
@@ -651,8 +651,7 @@ namespace volume {
 			_ITERATE_BEGIN
 				this->voxel[i][j][k].getPD(vVol[i][j][k], useFA);
 			_ITERATE_END
-			clock_t t2 = clock();
-			cout << "Done in " << (t2 - t1)/(double)CLOCKS_PER_SEC << 's' << endl;
+			cout << "Done in " << timer.elapsed() << 's' << endl;
 			vv->setName(getFilenameForSymTensor3DVolumeDerived(this->name.c_str(), "pd"));
 			return vv;
 		}
@@ -663,8 +662,9 @@ namespace volume {
 			} else {
 				cout << "Computing the RGB map ... " << flush;
 			}
-			clock_t t1 = clock();
+			ScopedTimer timer("TransformSymTensor3DVolume::getPDColorCode");
 			_SIZE
+			timer.addVoxels((unsigned long long)xsize * ysize * zsize);
 			Vector3DVolume *vv = new Vector3DVolume(this->size);
 			vv->setOrigin(this->origin);
 			vv->setVSize(this->vsize);
@@ -672,8 +672,7 @@ namespace volume {
 			_ITERATE_BEGIN
 				this->voxel[i][j][k].getPDColorCode(vVol[i][j][k], useFA, scale);
 			_ITERATE_END
-			clock_t t2 = clock();
-			cout << "Done in " << (t2 - t1)/(double)CLOCKS_PER_SEC << 's' << endl;
+			cout << "Done in " << timer.elapsed() << 's' << endl;
 			vv->setName(getFilenameForSymTensor3DVolumeDerived(this->name.c_str(), "rgb"));
 			return vv;
 		}
@@ -28,8 +28,38 @@
 #define _volume_TransformVolume_H
 
 #include "Volume.h"
+#include <vector>
+
+namespace geometry {
+	class Affine3D;
+	class Rigid3D;
+	class Translation3D;
+}
 
 namespace volume {
+	
+	// whether the transformation is linear, in which case the voxel
+	// it maps to moves by a constant step along the k axis
+	template <class Transform>
+	struct LinearTransformTraits {
+		enum { linear = 0 };
+	};
+	
+	template <>
+	struct LinearTransformTraits<Affine3D> {
+		enum { linear = 1 };
+	};
+	
+	template <>
+	struct LinearTransformTraits<Rigid3D> {
+		enum { linear = 1 };
+	};
+	
+	template <>
+	struct LinearTransformTraits<Translation3D> {
+		enum { linear = 1 };
+	};
+	
 	// macros for iteration
 	#define _SIZE const int xsize = this->size[0]; const int ysize = this->size[1]; const int zsize = this->size[2];
 	#define _ITERATE_BEGIN for (int i = 0; i < xsize; ++i) { for (int j = 0; j < ysize; ++j) { for (int k = 0; k < zsize; ++k) {
@@ -178,7 +208,10 @@ namespace volume {
 			if (backward) {
 				computeTransformBackward(out, intp);
 			} else {
-				computeTransformForward(out, intp);
+				int out_size[3];
+				out.getSize(out_size);
+				Volume<double> normalize(out_size);
+				computeTransformForward(out, normalize, intp);
 			}
 		}
 		
@@ -199,29 +232,75 @@ namespace volume {
 			int ysize = out.getYSize();
 			int zsize = out.getZSize();
 			
+			if (intp == 2) {
+				this->ensureBSplineCoefficients();
+			}
+			
 			cout << "backward resampling ..." << flush;
-			clock_t t1 = clock();
+			ScopedTimer timer("TransformVolume::computeTransformBackward");
+			timer.addVoxels((unsigned long long)xsize * ysize * zsize);
 			
+			if (LinearTransformTraits<Transform>::linear) {
+				computeTransformBackwardLinear(out, intp);
+			} else {
+				Vector3D vec;
+				_ITERATE_BEGIN
+					// vector at (i,j,k) of volume out
+					vec[0] = i;
+					vec[1] = j;
+					vec[2] = k;
+					out.toAbs(vec);
+					
+					// trans is the INVERSE transformation
+					vec *= trans;
+					
+					if (this->getVoxelAt(vec, out.voxel[i][j][k], intp)) {
+						// if within range
+						// reorientation, for tensor objects, for instance
+						objectSpecificTransformInverse(out.voxel[i][j][k]);
+					}
+				_ITERATE_END
+			}
+			
+			cout << "time consumed = " << timer.elapsed() << endl;
+		}
+		
+		// backward resampling for a linear transformation
+		// 
+		// only the first two voxels of every row of out are mapped,
+		// the rest of the row follows from the constant step
+		void computeTransformBackwardLinear (Volume<Object>& out, const int intp = 0) const {
+			const int xsize = out.getXSize();
+			const int ysize = out.getYSize();
+			const int zsize = out.getZSize();
+			
+			bool *inside = new bool[zsize];
 			Vector3D vec;
-			_ITERATE_BEGIN
-				// vector at (i,j,k) of volume out
-				vec[0] = i;
-				vec[1] = j;
-				vec[2] = k;
-				out.toAbs(vec);
-				
-				// trans is the INVERSE transformation
-				vec *= trans;
-				
-				if (this->getVoxelAt(vec, out.voxel[i][j][k], intp)) {
-					// if within range
-					// reorientation, for tensor objects, for instance
-					objectSpecificTransformInverse(out.voxel[i][j][k]);
+			Vector3D inc;
+			for (int i = 0; i < xsize; ++i) {
+				for (int j = 0; j < ysize; ++j) {
+					vec[0] = i;
+					vec[1] = j;
+					vec[2] = 0;
+					out.toAbs(vec);
+					vec *= trans;
+					inc[0] = i;
+					inc[1] = j;
+					inc[2] = 1;
+					out.toAbs(inc);
+					inc *= trans;
+					inc -= vec;
+					
+					Object *row = out.voxel[i][j];
+					this->getVoxelRun(vec, inc, zsize, row, inside, intp);
+					for (int k = 0; k < zsize; ++k) {
+						if (inside[k]) {
+							objectSpecificTransformInverse(row[k]);
+						}
+					}
 				}
-			_ITERATE_END
-			
-			clock_t t2 = clock();
-			cout << "time consumed = " << (t2 - t1)/(double)CLOCKS_PER_SEC << endl;
+			}
+			delete[] inside;
 		}
 		
 		// compute the FORWARD transformed object projected onto the grid
@@ -232,22 +311,57 @@ namespace volume {
 		// 
 		// make sure the reorientation matrix is the
 		// jacobian of the inverse transformation
+		// 
+		// when intp != 0, the coefficient normalization is not applied;
+		// use the version below to get it
 		void computeTransformForward (Volume<Object>& out, const int intp = 0) const {
+			int out_size[3];
+			out.getSize(out_size);
+			Volume<double> normalize(out_size);
+			computeTransformForward(out, normalize, intp);
+		}
+		
+		// forward resampling with the normalization coefficients returned
+		// in normalize, a volume of the size of out.  out is divided by
+		// them when intp == 0 only.
+		// 
+		// out is partitioned into tiles of tileSize voxels a side.  the
+		// first pass maps every voxel of *this and bins it by the tile of
+		// the bottom left corner of its interpolation cube; the second
+		// accumulates the voxels a tile at a time.  a cube reaches at
+		// most one voxel into the next tile along each axis, so the tiles
+		// are processed in 8 rounds by the parity of their tile indices:
+		// the tiles of a round never share a voxel and are accumulated in
+		// parallel without atomics.
+		// 
+		// the first pass is parallel for the linear transformations only,
+		// the others keep the jacobian of the current point in the
+		// transformation.  the reorientation of the voxels that land in
+		// out is serial for every transformation, for the same reason,
+		// and kept until the second pass: a copy of those voxels, on top
+		// of the 48 bytes of interpolation cube and binning per voxel of
+		// *this
+		void computeTransformForward (Volume<Object>& out, Volume<double>& normalize, const int intp = 0, int tileSize = 16) const {
 			const int xsize = this->size[0];
 			const int ysize = this->size[1];
 			const int zsize = this->size[2];
+			const bool linear = LinearTransformTraits<Transform>::linear;
 			
 			cout << "forward resampling ..." << flush;
-			clock_t t1 = clock();
+			ScopedTimer timer("TransformVolume::computeTransformForward");
+			timer.addVoxels((unsigned long long)xsize * ysize * zsize);
 			
-			// a volume to store the normalization coefficients
+			// the volume storing the normalization coefficients
 			int out_size[3];
 			double out_vsize[3];
 			double out_origin[3];
 			out.getSize(out_size);
 			out.getVSize(out_vsize);
 			out.getOrigin(out_origin);
-			Volume<double> normalize(out_size);
+			if (!normalize.checkSize(out_size)) {
+				cerr << "The normalization volume must have the size of the output" << endl;
+				exit(1);
+			}
 			normalize.setVSize(out_vsize);
 			normalize.setOrigin(out_origin);
 			normalize.setBackground(0.0);
@@ -256,35 +370,120 @@ namespace volume {
 			// remember to set the background
 			out.fillWithBackground();
 			
-			Vector3D vec;
-			_ITERATE_BEGIN
-				// vector at (i,j,k) of *this volume
-				vec[0] = i;
-				vec[1] = j;
-				vec[2] = k;
-				this->toAbs(vec);
-				
-				// trans is the INVERSE transformation
-				vec *= trans;
-				
-				// reorientation, for tensor objects, for instance
-				// use a copy to avoid modifying the original
-				Object current = this->voxel[i][j][k];
-				objectSpecificTransform(current);
-				out.putVoxelAt(vec, current, normalize);
-			_ITERATE_END
+			// the tiles
+			if (tileSize < 2) {
+				tileSize = 2;
+			}
+			int tiles[3];
+			for (int m = 0; m < 3; ++m) {
+				tiles[m] = (out_size[m] + tileSize - 1) / tileSize;
+			}
+			const int tileCount = tiles[0] * tiles[1] * tiles[2];
+			
+			// first pass: the interpolation cube and the tile of every voxel
+			const long n = (long)xsize * ysize * zsize;
+			vector<int> bottomLefts(3 * n);
+			vector<double> lambdas(3 * n);
+			vector<int> tileOf(n);
+#ifdef _OPENMP
+#pragma omp parallel for if (linear)
+#endif
+			for (int i = 0; i < xsize; ++i) {
+				Vector3D vec;
+				for (int j = 0; j < ysize; ++j) {
+					for (int k = 0; k < zsize; ++k) {
+						const long index = ((long)i * ysize + j) * zsize + k;
+						// vector at (i,j,k) of *this volume
+						vec[0] = i;
+						vec[1] = j;
+						vec[2] = k;
+						this->toAbs(vec);
+						
+						// trans is the INVERSE transformation
+						vec *= trans;
+						
+						int *bottomLeft = &bottomLefts[3 * index];
+						if (!out.computeBottomLeftCornerIndexAndLambdaRegion(vec, bottomLeft, &lambdas[3 * index])) {
+							tileOf[index] = -1;
+							continue;
+						}
+						int tile = 0;
+						for (int m = 0; m < 3; ++m) {
+							const int b = bottomLeft[m] < 0 ? 0 : bottomLeft[m];
+							tile = tile * tiles[m] + b / tileSize;
+						}
+						tileOf[index] = tile;
+					}
+				}
+			}
+			
+			// the voxels binned by tile
+			vector<long> first(tileCount + 1, 0);
+			for (long index = 0; index < n; ++index) {
+				if (tileOf[index] >= 0) {
+					++first[tileOf[index] + 1];
+				}
+			}
+			for (int t = 0; t < tileCount; ++t) {
+				first[t + 1] += first[t];
+			}
+			vector<long> binned(first[tileCount]);
+			{
+				vector<long> next(first.begin(), first.end() - 1);
+				for (long index = 0; index < n; ++index) {
+					if (tileOf[index] >= 0) {
+						binned[next[tileOf[index]]++] = index;
+					}
+				}
+			}
+			
+			// reorientation, for tensor objects, for instance
+			// use a copy to avoid modifying the original
+			vector<Object> objects(binned.size());
+			for (size_t b = 0; b < binned.size(); ++b) {
+				const long index = binned[b];
+				const int i = index / ((long)ysize * zsize);
+				const int j = (index / zsize) % ysize;
+				const int k = index % zsize;
+				objects[b] = this->voxel[i][j][k];
+				objectSpecificTransform(objects[b]);
+			}
+			
+			// second pass: the tiles of the same parity in parallel
+			for (int parity = 0; parity < 8; ++parity) {
+				vector<int> round;
+				for (int t = 0; t < tileCount; ++t) {
+					const int tz = t % tiles[2];
+					const int ty = (t / tiles[2]) % tiles[1];
+					const int tx = t / (tiles[2] * tiles[1]);
+					if ((tx & 1) + 2 * (ty & 1) + 4 * (tz & 1) == parity && first[t + 1] > first[t]) {
+						round.push_back(t);
+					}
+				}
+				const int roundSize = round.size();
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+				for (int r = 0; r < roundSize; ++r) {
+					int cornerIndex[2][2][2][3];
+					Object *corner[2][2][2];
+					double *corner2[2][2][2];
+					const int t = round[r];
+					for (long b = first[t]; b < first[t + 1]; ++b) {
+						const long index = binned[b];
+						out.computeCornerIndices(&bottomLefts[3 * index], cornerIndex);
+						out.computeCornerObjects(out.voxel, cornerIndex, corner, normalize, corner2);
+						out.distribute8(objects[b], corner, corner2, &lambdas[3 * index]);
+					}
+				}
+			}
 			
 			if (intp == 0) {
 				// apply the coefficient normalization
 				out.divide(normalize, 0.0);
 			}
 			
-			clock_t t2 = clock();
-			cout << "time consumed = " << (t2 - t1)/(double)CLOCKS_PER_SEC << endl;
-			if (intp != 0) {
-				// save the coefficient normalization if not applied
-				normalize.writeScalarNifti("normalize.nii.gz");
-			}
+			cout << "time consumed = " << timer.elapsed() << endl;
 		}
 		
 		double computeSimilarityRegion () {
@@ -318,6 +517,10 @@ namespace volume {
 			// macros
 			_COMMON_OBJ
 			
+			if (intp == 2) {
+				vol.ensureBSplineCoefficients();
+			}
+			
 			Vector3D vec;
 			double sum = 0.0;
 			
@@ -367,10 +570,9 @@ namespace volume {
 		double computeSimilarityRegionWithInfo (const Volume<Object>& vol, const Volume<double> *mask, int intp) {
 			cout << "Computing the image similarity between ";
 			cout << this->name << " and " << vol.getName() << " ... " << flush;
-			clock_t t1 = clock();
+			ScopedTimer timer("TransformVolume::computeSimilarityRegionWithInfo");
 			const double similarity = computeSimilarityRegion(vol, mask, intp);
-			clock_t t2 = clock();
-			cout << "Done in " << (t2 - t1)/(double)CLOCKS_PER_SEC << 's' << endl;
+			cout << "Done in " << timer.elapsed() << 's' << endl;
 			cout << "Similarity = " << similarity << endl;
 			return similarity;
 		}
@@ -380,14 +582,18 @@ namespace volume {
 		double computeSimilarityGradientRegion (const Volume<Object>& vol, const Volume<double> *mask,
 			double *xi, int xiDim, int intp) {
 			// make sure the subject's gradient volumes are computed
-			if (!vol.getGradEnabled()) {
-				cerr << "The subject volume has gradient feature disabled" << endl;
-				exit(1);
-			}
-			
+			// the cubic B-spline has its own analytic gradient
 			switch (intp) {
+				case 2:
+					vol.ensureBSplineCoefficients();
+					break;
 				default:
-				case 0: break;
+				case 0:
+					if (!vol.getGradEnabled()) {
+						cerr << "The subject volume has gradient feature disabled" << endl;
+						exit(1);
+					}
+					break;
 			}
 			
 			// macros
@@ -0,0 +1,146 @@
+/*============================================================================
+
+  Program:     DTI ToolKit (DTI-TK)
+  Module:      $RCSfile: TrilinearInterpolation.h,v $
+  Language:    C++
+  Date:        $Date: 2026/10/18 14:32:40 $
+  Version:     $Revision: 1.1 $
+
+  Copyright (c) Gary Hui Zhang (garyhuizhang@gmail.com).
+  All rights reserverd.
+
+  DTI-TK is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  DTI-TK is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with DTI-TK.  If not, see <http://www.gnu.org/licenses/>.
+============================================================================*/
+
+
+// trilinear interpolation kernels
+//
+// declaration and implementation
+//
+// Volume<Object> interpolates through TrilinearInterpolation<Object>.
+// the generic version uses the Object arithmetic; the specializations
+// for double, Vector3D and SymTensor3D work on the components directly
+// with no temporary objects, so the seven lerps of every component stay
+// in registers and the component loop can be vectorized.
+//
+// the order of the operations is the same as in the generic version:
+// along x, then y, then z, each lerp being c0 * (1 - lambda) + lambda * c1,
+// so the specializations give identical results.
+//
+// the corners are given in the order [z][y][x], as in Volume.
+
+#ifndef _volume_TrilinearInterpolation_H
+#define _volume_TrilinearInterpolation_H
+
+#include "../geometry/Vector3D.h"
+#include "../geometry/SymTensor3D.h"
+
+namespace volume {
+	
+	using namespace geometry;
+	
+	// the component kernel shared by the specializations
+	template <int N>
+	inline void trilinearComponents (
+		const double *c000, const double *c001,
+		const double *c010, const double *c011,
+		const double *c100, const double *c101,
+		const double *c110, const double *c111,
+		const double lambda[3], double *out) {
+		const double lx = lambda[0];
+		const double ly = lambda[1];
+		const double lz = lambda[2];
+		const double mx = 1 - lx;
+		const double my = 1 - ly;
+		const double mz = 1 - lz;
+		for (int m = 0; m < N; ++m) {
+			const double c00 = c000[m] * mx + lx * c001[m];
+			const double c01 = c010[m] * mx + lx * c011[m];
+			const double c10 = c100[m] * mx + lx * c101[m];
+			const double c11 = c110[m] * mx + lx * c111[m];
+			const double c0 = c00 * my + ly * c01;
+			const double c1 = c10 * my + ly * c11;
+			out[m] = c0 * mz + lz * c1;
+		}
+	}
+	
+	template <class Object>
+	struct TrilinearInterpolation {
+		static Object interpolate2 (const Object& c0, const Object& c1, const double lambda) {
+			Object tmp(c0);
+			tmp *= 1 - lambda;
+			tmp += lambda * c1;
+			return tmp;
+		}
+		
+		static void interpolate8 (
+			const Object& c000, const Object& c001,
+			const Object& c010, const Object& c011,
+			const Object& c100, const Object& c101,
+			const Object& c110, const Object& c111,
+			const double lambda[3], Object& out) {
+			out = interpolate2(
+					interpolate2(
+						interpolate2(c000, c001, lambda[0]),
+						interpolate2(c010, c011, lambda[0]),
+						lambda[1]),
+					interpolate2(
+						interpolate2(c100, c101, lambda[0]),
+						interpolate2(c110, c111, lambda[0]),
+						lambda[1]),
+					lambda[2]);
+		}
+	};
+	
+	template <>
+	struct TrilinearInterpolation<double> {
+		static void interpolate8 (
+			const double& c000, const double& c001,
+			const double& c010, const double& c011,
+			const double& c100, const double& c101,
+			const double& c110, const double& c111,
+			const double lambda[3], double& out) {
+			trilinearComponents<1>(&c000, &c001, &c010, &c011,
+				&c100, &c101, &c110, &c111, lambda, &out);
+		}
+	};
+	
+	template <>
+	struct TrilinearInterpolation<Vector3D> {
+		static void interpolate8 (
+			const Vector3D& c000, const Vector3D& c001,
+			const Vector3D& c010, const Vector3D& c011,
+			const Vector3D& c100, const Vector3D& c101,
+			const Vector3D& c110, const Vector3D& c111,
+			const double lambda[3], Vector3D& out) {
+			trilinearComponents<3>(&c000[0], &c001[0], &c010[0], &c011[0],
+				&c100[0], &c101[0], &c110[0], &c111[0], lambda, &out[0]);
+		}
+	};
+	
+	template <>
+	struct TrilinearInterpolation<SymTensor3D> {
+		static void interpolate8 (
+			const SymTensor3D& c000, const SymTensor3D& c001,
+			const SymTensor3D& c010, const SymTensor3D& c011,
+			const SymTensor3D& c100, const SymTensor3D& c101,
+			const SymTensor3D& c110, const SymTensor3D& c111,
+			const double lambda[3], SymTensor3D& out) {
+			trilinearComponents<6>(&c000[0], &c001[0], &c010[0], &c011[0],
+				&c100[0], &c101[0], &c110[0], &c111[0], lambda, &out[0]);
+		}
+	};
+}
+
+#endif
@@ -38,10 +38,13 @@
 #include "../geometry/Vector3D.h"
 #include "../geometry/SymTensor3D.h"
 #include "../geometry/Reflection3D.h"
+#include "TrilinearInterpolation.h"
+#include "CubicBSplineInterpolation.h"
 #include "nifti1_io.h"
 #include "../io/VTKReader.h"
 #include "../io/VTKWriter.h"
 #include "../io/util.h"
+#include "../io/Profiler.h"
 #include <iostream>
 #include <iomanip>
 #include <ctime>
@@ -64,6 +67,9 @@ namespace volume {
 		
 		// gradient info
 		Object ***grad[3];
+		
+		// cubic B-spline coefficients, see buildBSplineCoefficients
+		Object ***coeff;
 				
 		protected:
 		// symbolic zero
@@ -75,6 +81,24 @@ namespace volume {
 		// gradient enabled flag
 		bool gradEnabled;
 		
+		public:
+		// when set, enabling the gradient does not allocate the grad
+		// volumes: the gradients are computed at the interpolation
+		// corners when needed, see getVoxelAt with gradOut.  this
+		// saves three volumes of Object per volume, e.g. 18 doubles
+		// per voxel for tensors, at the cost of recomputing the
+		// central differences on every call
+		// 
+		// smoothing before differentiation (buildGradient with sigma)
+		// still requires the stored gradients
+		static bool GradientOnDemand;
+		
+		static void setGradientOnDemand (const bool in) {
+			GradientOnDemand = in;
+		}
+		
+		protected:
+		
 		// persistent local variables
 	 	// cornersIndex:
 		// index of four corners of a square for interpolation
@@ -107,6 +131,7 @@ namespace volume {
 		// xsize, ysize etc.  no allocation is possible
 		Volume (bool enableGrad = false) : VoxelSpace() {
 			voxel = NULL;
+			coeff = NULL;
 			gradEnabled = enableGrad;
 			for (int i = 0; i < 3; ++i) {
 				grad[i] = NULL;
@@ -219,7 +244,8 @@ namespace volume {
 			cout << setw(4) << sigma[1] << ", ";
 			cout << setw(4) << sigma[2];
 			cout << "] ... " << flush;
-			clock_t t1 = clock();
+			ScopedTimer timer("Volume::gaussianSmoothing");
+			timer.addVoxels((unsigned long long)size[0] * size[1] * size[2]);
 			
 			// internal buffer volume
 			Object ***buffer = allocate();
@@ -245,8 +271,7 @@ namespace volume {
 				voxel = buffer;
 			}
 			
-			clock_t t2 = clock();
-			cout << "Done in " << (t2 - t1)/(double)CLOCKS_PER_SEC << 's' << endl;
+			cout << "Done in " << timer.elapsed() << 's' << endl;
 		}
 		
 		// input/output
@@ -280,14 +305,13 @@ namespace volume {
 			
 			// z first
 			cout << "Reading the buffer ... " << flush;
-			clock_t t1 = clock();
+			ScopedTimer timer("Volume::readVTKVol");
 			for (int k = 0; k < size[2]; ++k) {
 				if (!readSliceAux(in, k)) {
 					return false;
 				}
 			}
-			clock_t t2 = clock();
-			cout << "Done in " << (t2 - t1)/(double)CLOCKS_PER_SEC << 's' << endl;
+			cout << "Done in " << timer.elapsed() << 's' << endl;
 			return true;
 		}
 		
@@ -312,14 +336,13 @@ namespace volume {
 			
 			// z first
 			cout << "Writing the buffer ... " << flush;
-			clock_t t1 = clock();
+			ScopedTimer timer("Volume::writeVTKVol");
 			for (int k = 0; k < size[2]; ++k) {
 				if (!writeSliceAux(out, vol, k)) {
 					return false;
 				}
 			}
-			clock_t t2 = clock();
-			cout << "Done in " << (t2 - t1)/(double)CLOCKS_PER_SEC << 's' << endl;
+			cout << "Done in " << timer.elapsed() << 's' << endl;
 			
 			return true;
 		}
@@ -343,10 +366,11 @@ namespace volume {
 		
 		Volume (const int sz[3], bool enableGrad = false) : VoxelSpace(sz) {
 			voxel = allocate();
+			coeff = NULL;
 			if (enableGrad) {
 				gradEnabled = true;
 				for (int i = 0 ; i < 3; ++i) {
-					grad[i] = allocate();
+					grad[i] = GradientOnDemand ? NULL : allocate();
 				}
 			} else {
 				gradEnabled = false;
@@ -358,10 +382,11 @@ namespace volume {
 		
 		Volume (const VoxelSpace& vs, bool enableGrad = false) : VoxelSpace(vs) {
 			voxel = allocate();
+			coeff = NULL;
 			if (enableGrad) {
 				gradEnabled = true;
 				for (int i = 0 ; i < 3; ++i) {
-					grad[i] = allocate();
+					grad[i] = GradientOnDemand ? NULL : allocate();
 				}
 			} else {
 				gradEnabled = false;
@@ -374,6 +399,7 @@ namespace volume {
 		virtual ~Volume () {
 			deallocate(voxel);
 			clearGradient();
+			clearBSplineCoefficients();
 		}
 		
 		void fillWithBackground () {
@@ -403,6 +429,16 @@ namespace volume {
 				gradEnabled = true;
 			}
 			
+			const bool smoothing = sigma != NULL && (sigma[0] != 0.0 || sigma[1] != 0.0 || sigma[2] != 0.0);
+			if (GradientOnDemand && !smoothing) {
+				// computed at the interpolation corners instead
+				for (int i = 0; i < 3; ++i) {
+					deallocate(grad[i]);
+					grad[i] = NULL;
+				}
+				return;
+			}
+			
 			// allocate space if not done so
 			if (grad[0] == NULL) {
 				for (int i = 0; i < 3; ++i) {
@@ -416,7 +452,7 @@ namespace volume {
 			// this will introduce additional smoothing that might
 			// not be required or desired in most cases
 			Object ***smooth = NULL;
-			if (sigma != NULL && (sigma[0] != 0.0 || sigma[1] != 0.0 || sigma[2] != 0.0)) {
+			if (smoothing) {
 				smooth = allocate();
 				gaussianSmoothing(sigma, smooth);
 			} else {
@@ -470,8 +506,116 @@ namespace volume {
 				gradEnabled = false;
 				for (int i = 0; i < 3; ++i) {
 					deallocate(grad[i]);
+					grad[i] = NULL;
+				}
+			}
+		}
+		
+		// the gradient of voxel at a grid point, as computed by
+		// buildGradient without smoothing: central differences
+		// with zero beyond the volume.  out of range points have
+		// the background as their gradient, like the corners
+		// outside the stored gradient volumes
+		void computeGradientAt (const int index[3], Object out[3]) const {
+			for (int m = 0; m < 3; ++m) {
+				if (index[m] < 0 || index[m] >= size[m]) {
+					for (int n = 0; n < 3; ++n) {
+						out[n] = bg;
+					}
+					return;
+				}
+			}
+			const int i = index[0];
+			const int j = index[1];
+			const int k = index[2];
+			const int hi[3] = {i + 1 < size[0], j + 1 < size[1], k + 1 < size[2]};
+			const int lo[3] = {i > 0, j > 0, k > 0};
+			out[0] = zero;
+			out[1] = zero;
+			out[2] = zero;
+			if (hi[0]) out[0] += voxel[i + 1][j][k];
+			if (lo[0]) out[0] -= voxel[i - 1][j][k];
+			if (hi[1]) out[1] += voxel[i][j + 1][k];
+			if (lo[1]) out[1] -= voxel[i][j - 1][k];
+			if (hi[2]) out[2] += voxel[i][j][k + 1];
+			if (lo[2]) out[2] -= voxel[i][j][k - 1];
+			for (int m = 0; m < 3; ++m) {
+				out[m] *= 0.5 / vsize[m];
+			}
+		}
+		
+		// computing the cubic B-spline coefficients of voxel
+		// 
+		// required by the cubic B-spline interpolation (intp = 2), which
+		// builds them on first use if needed
+		// the coefficients are not updated when voxel changes, so
+		// rebuild them after modifying the volume
+		void buildBSplineCoefficients () {
+			cout << "Computing the cubic B-spline coefficients ... " << flush;
+			ScopedTimer timer("Volume::buildBSplineCoefficients");
+			
+			// a first build is only published once complete
+			Object ***built = coeff != NULL ? coeff : allocate();
+			for (int i = 0; i < size[0]; ++i) {
+				for (int j = 0; j < size[1]; ++j) {
+					for (int k = 0; k < size[2]; ++k) {
+						built[i][j][k] = voxel[i][j][k];
+					}
+				}
+			}
+			
+			// the rows along z are contiguous
+			for (int i = 0; i < size[0]; ++i) {
+				for (int j = 0; j < size[1]; ++j) {
+					CubicBSplineInterpolation<Object>::prefilterLine(built[i][j], size[2]);
+				}
+			}
+			// the other two directions go through a line buffer
+			Object *line = new Object[size[0] > size[1] ? size[0] : size[1]];
+			for (int i = 0; i < size[0]; ++i) {
+				for (int k = 0; k < size[2]; ++k) {
+					for (int j = 0; j < size[1]; ++j) {
+						line[j] = built[i][j][k];
+					}
+					CubicBSplineInterpolation<Object>::prefilterLine(line, size[1]);
+					for (int j = 0; j < size[1]; ++j) {
+						built[i][j][k] = line[j];
+					}
+				}
+			}
+			for (int j = 0; j < size[1]; ++j) {
+				for (int k = 0; k < size[2]; ++k) {
+					for (int i = 0; i < size[0]; ++i) {
+						line[i] = built[i][j][k];
+					}
+					CubicBSplineInterpolation<Object>::prefilterLine(line, size[0]);
+					for (int i = 0; i < size[0]; ++i) {
+						built[i][j][k] = line[i];
+					}
 				}
 			}
+			delete[] line;
+			coeff = built;
+			
+			cout << "Done in " << timer.elapsed() << 's' << endl;
+		}
+		
+		// the coefficients are a cache of voxel: build them if missing
+		// 
+		// call before a parallel loop interpolating with intp = 2
+		void ensureBSplineCoefficients () const {
+			if (coeff == NULL) {
+				const_cast<Volume<Object> *>(this)->buildBSplineCoefficients();
+			}
+		}
+		
+		void clearBSplineCoefficients () {
+			deallocate(coeff);
+			coeff = NULL;
+		}
+		
+		bool getBSplineCoefficientsBuilt () const {
+			return coeff != NULL;
 		}
 		
 		void gaussianSmoothing (const double sigma = 1.0) {
@@ -514,7 +658,7 @@ namespace volume {
 		Volume<Object>& operator+= (const Volume<Object>& rhs) {
 			cout << "Adding " << rhs.getName() << " to ";
 			cout << this->name << " ... " << flush;
-			clock_t t1 = clock();
+			ScopedTimer timer("Volume::operator+=");
 			for (int i = 0; i < size[0]; ++i) {
 				for (int j = 0; j < size[1]; ++j) {
 					for (int k = 0; k < size[2]; ++k) {
@@ -522,8 +666,7 @@ namespace volume {
 					}
 				}
 			}
-			clock_t t2 = clock();
-			cout << "Done in " << (t2 - t1)/(double)CLOCKS_PER_SEC << 's' << endl;
+			cout << "Done in " << timer.elapsed() << 's' << endl;
 			this->setName(getFilenameForSymTensor3DVolumeDerived(this->name.c_str(), "add"));
 			return *this;
 		}
@@ -533,7 +676,7 @@ namespace volume {
 		Volume<Object>& operator-= (const Volume<Object>& rhs) {
 			cout << "Subtracting " << rhs.getName() << " from ";
 			cout << this->name << " ... " << flush;
-			clock_t t1 = clock();
+			ScopedTimer timer("Volume::operator-=");
 			for (int i = 0; i < size[0]; ++i) {
 				for (int j = 0; j < size[1]; ++j) {
 					for (int k = 0; k < size[2]; ++k) {
@@ -541,8 +684,7 @@ namespace volume {
 					}
 				}
 			}
-			clock_t t2 = clock();
-			cout << "Done in " << (t2 - t1)/(double)CLOCKS_PER_SEC << 's' << endl;
+			cout << "Done in " << timer.elapsed() << 's' << endl;
 			this->setName(getFilenameForSymTensor3DVolumeDerived(this->name.c_str(), "subtract"));
 			return *this;
 		}
@@ -551,7 +693,7 @@ namespace volume {
 		Volume<Object>& operator*= (double rhs) {
 			cout << "Voxelwise scaling " << this->name << " by ";
 			cout << rhs << " ... " << flush;
-			clock_t t1 = clock();
+			ScopedTimer timer("Volume::operator*=");
 			for (int i = 0; i < size[0]; ++i) {
 				for (int j = 0; j < size[1]; ++j) {
 					for (int k = 0; k < size[2]; ++k) {
@@ -559,8 +701,7 @@ namespace volume {
 					}
 				}
 			}
-			clock_t t2 = clock();
-			cout << "Done in " << (t2 - t1)/(double)CLOCKS_PER_SEC << 's' << endl;
+			cout << "Done in " << timer.elapsed() << 's' << endl;
 			this->setName(getFilenameForSymTensor3DVolumeDerived(this->name.c_str(), "scale"));
 			return *this;
 		}
@@ -569,7 +710,7 @@ namespace volume {
 		Volume<Object>& divide (const Volume<double>& rhs, const double tiny = 1.0) {
 			cout << "Dividing " << this->name << " by ";
 			cout << rhs.getName() << " ... " << flush;
-			clock_t t1 = clock();
+			ScopedTimer timer("Volume::divide");
 			for (int i = 0; i < size[0]; ++i) {
 				for (int j = 0; j < size[1]; ++j) {
 					for (int k = 0; k < size[2]; ++k) {
@@ -581,8 +722,7 @@ namespace volume {
 					}
 				}
 			}
-			clock_t t2 = clock();
-			cout << "Done in " << (t2 - t1)/(double)CLOCKS_PER_SEC << 's' << endl;
+			cout << "Done in " << timer.elapsed() << 's' << endl;
 			this->setName(getFilenameForSymTensor3DVolumeDerived(this->name.c_str(), "divide"));
 			return *this;
 		}
@@ -592,7 +732,7 @@ namespace volume {
 		Volume<Object>& mosaicCompositionWith (const Volume<Object>& rhs, int mosaic) {
 			cout << "Mosaicing " << this->name << " with ";
 			cout << rhs.getName() << " ... " << flush;
-			clock_t t1 = clock();
+			ScopedTimer timer("Volume::mosaicCompositionWith");
 			for (int i = 0; i < size[0]; ++i) {
 				for (int j = 0; j < size[1]; ++j) {
 					if ((i/mosaic)%2 == (j/mosaic)%2) {
@@ -602,8 +742,7 @@ namespace volume {
 					}
 				}
 			}
-			clock_t t2 = clock();
-			cout << "Done in " << (t2 - t1)/(double)CLOCKS_PER_SEC << 's' << endl;
+			cout << "Done in " << timer.elapsed() << 's' << endl;
 			this->setName(getFilenameForSymTensor3DVolumeDerived(this->name.c_str(), "mosaic"));
 			return *this;
 		}
@@ -613,8 +752,43 @@ namespace volume {
 			return gradEnabled;
 		}
 		
+		// cubic B-spline interpolation at vec, with the gradient if
+		// gradOut is not NULL
+		// 
+		// the range is the same as for the trilinear interpolation;
+		// beyond the volume the coefficients are mirrored
+		bool getVoxelAtBSpline (const Vector3D& vec, Object& out, Object *gradOut) const {
+			if (coeff == NULL) {
+#ifdef _OPENMP
+#pragma omp critical (Volume_buildBSplineCoefficients)
+#endif
+				ensureBSplineCoefficients();
+			}
+			int bottomLeft[3];
+			double lambda[3];
+			if (!computeBottomLeftCornerIndexAndLambdaRegion(vec, bottomLeft, lambda)) {
+				out = bg;
+				return false;
+			}
+			CubicBSplineAxis axis[3];
+			double ivsize[3];
+			for (int m = 0; m < 3; ++m) {
+				axis[m].set(bottomLeft[m] + lambda[m], size[m]);
+				ivsize[m] = 1.0 / vsize[m];
+			}
+			CubicBSplineInterpolation<Object>::evaluate(coeff, axis, ivsize, zero, out, gradOut);
+			return true;
+		}
+		
 		// the backward resampling function
+		// 
+		// intp = 0: trilinear
+		// intp = 2: cubic B-spline, the coefficients built on first use
+		// otherwise: nearest neighbour
 		bool getVoxelAt (const Vector3D& vec, Object& out, const int intp = 0) const {
+			if (intp == 2) {
+				return getVoxelAtBSpline(vec, out, NULL);
+			}
 			// more efficient to use local variables 
 			// macro
 			if (intp != 0) {
@@ -638,7 +812,7 @@ namespace volume {
 			if (computeBottomLeftCornerIndexAndLambdaRegion(vec, bottomLeft, lambda)) {
 				computeCornerIndices(bottomLeft, cornerIndex);
 				computeCornerObjects(cornerIndex, corner);
-				out = interpolate8(corner, lambda);
+				interpolate8(corner, lambda, out);
 				return true;
 			} else {
 				out = bg;
@@ -646,7 +820,70 @@ namespace volume {
 			}
 		}
 		
+		// backward resampling along a line
+		//
+		// the n points vec + t * inc, t = 0, ..., n - 1, are resampled
+		// into out[t], inside[t] is set as the return value of
+		// getVoxelAt.  vec and inc are in the absolute scale
+		//
+		// for a linear mapping this replaces the per voxel toRel,
+		// floor and corner index computations with a constant step.
+		// the points whose interpolation cube lies within the region
+		// are interpolated directly from four contiguous rows; the
+		// rest go through getVoxelAt
+		void getVoxelRun (const Vector3D& vec, const Vector3D& inc, const int n,
+			Object *out, bool *inside, const int intp = 0) const {
+			Vector3D rel(vec);
+			toRel(rel);
+			Vector3D relInc(vec);
+			relInc += inc;
+			toRel(relInc);
+			relInc -= rel;
+			
+			// the interpolation cube [b, b + 1] must fit in the region
+			double lo[3];
+			double hi[3];
+			for (int m = 0; m < 3; ++m) {
+				lo[m] = regionOriginRel[m];
+				hi[m] = regionEndRel[m] - 1;
+			}
+			
+			double lambda[3];
+			for (int t = 0; t < n; ++t) {
+				const double x = rel[0] + t * relInc[0];
+				const double y = rel[1] + t * relInc[1];
+				const double z = rel[2] + t * relInc[2];
+				if (intp != 0 || x < lo[0] || x >= hi[0] || y < lo[1] || y >= hi[1] || z < lo[2] || z >= hi[2]) {
+					Vector3D loc(inc);
+					loc *= t;
+					loc += vec;
+					inside[t] = getVoxelAt(loc, out[t], intp);
+					continue;
+				}
+				// non-negative here, so truncation is the floor
+				const int bx = (int)x;
+				const int by = (int)y;
+				const int bz = (int)z;
+				lambda[0] = x - bx;
+				lambda[1] = y - by;
+				lambda[2] = z - bz;
+				const Object *r00 = &voxel[bx][by][bz];
+				const Object *r01 = &voxel[bx + 1][by][bz];
+				const Object *r10 = &voxel[bx][by + 1][bz];
+				const Object *r11 = &voxel[bx + 1][by + 1][bz];
+				TrilinearInterpolation<Object>::interpolate8(r00[0], r01[0], r10[0], r11[0],
+					r00[1], r01[1], r10[1], r11[1], lambda, out[t]);
+				inside[t] = true;
+			}
+		}
+		
 		bool getVoxelAt (const Vector3D& vec, Object& out, Object gradOut[3], const int intp = 0) const {
+			// the analytic derivatives of the spline do not
+			// need the gradient volumes
+			if (intp == 2) {
+				return getVoxelAtBSpline(vec, out, gradOut);
+			}
+			
 			// macro
 			_COMMON_VAR
 			if (computeBottomLeftCornerIndexAndLambdaRegion(vec, bottomLeft, lambda)) {
@@ -654,15 +891,42 @@ namespace volume {
 				computeCornerObjects(cornerIndex, corner);
 				switch (intp) {
 					default:
-					case 0: out = interpolate8(corner, lambda);
+					case 0: interpolate8(corner, lambda, out);
 						   break;
 				}
 				
+				if (grad[0] == NULL) {
+					// the gradients at the corners on demand
+					Object cornerGrad[3][2][2][2];
+					Object g[3];
+					for (int k = 0; k < 2; ++k) {
+						for (int j = 0; j < 2; ++j) {
+							for (int i = 0; i < 2; ++i) {
+								computeGradientAt(cornerIndex[k][j][i], g);
+								for (int m = 0; m < 3; ++m) {
+									cornerGrad[m][k][j][i] = g[m];
+								}
+							}
+						}
+					}
+					for (int m = 0; m < 3; ++m) {
+						for (int k = 0; k < 2; ++k) {
+							for (int j = 0; j < 2; ++j) {
+								for (int i = 0; i < 2; ++i) {
+									corner[k][j][i] = &cornerGrad[m][k][j][i];
+								}
+							}
+						}
+						interpolate8(corner, lambda, gradOut[m]);
+					}
+					return true;
+				}
+				
 				for (int i = 0; i < 3; ++i) {
 					computeGradCornerObjects(i, cornerIndex, corner);
 					switch (intp) {
 						default:
-						case 0: gradOut[i] = interpolate8(corner, lambda);
+						case 0: interpolate8(corner, lambda, gradOut[i]);
 							   break;
 					}
 				}
@@ -697,7 +961,7 @@ namespace volume {
       cout << "Replacing the voxels in " << mask->getName();
       cout << " with the voxels of its mirror reflection about midsaggital ";
       cout << " ... " << flush;
-      clock_t t1 = clock();
+      ScopedTimer timer("Volume::replacementWithReflection");
       for (int i = 0; i < size[0]; ++i) {
         for (int j = 0; j < size[1]; ++j) {
           for (int k = 0; k < size[2]; ++k) {
@@ -725,8 +989,7 @@ namespace volume {
           }
         }
       }*/
-      clock_t t2 = clock();
-			cout << "Done in " << (t2 - t1)/(double)CLOCKS_PER_SEC << 's' << endl;
+			cout << "Done in " << timer.elapsed() << 's' << endl;
 			this->setName(getFilenameForSymTensor3DVolumeDerived(this->name.c_str(), "replacement"));
 			return *this;
     }
@@ -872,12 +1135,21 @@ namespace volume {
 		
 		Object interpolate8 (
 			const Object *corner[2][2][2], const double lambda[3]) const {
-			return interpolate8(
+			Object out;
+			interpolate8(corner, lambda, out);
+			return out;
+		}
+		
+		// the trilinear kernel is chosen at compile time from Object,
+		// see TrilinearInterpolation.h
+		void interpolate8 (
+			const Object *corner[2][2][2], const double lambda[3], Object& out) const {
+			TrilinearInterpolation<Object>::interpolate8(
 				*corner[0][0][0], *corner[0][0][1],
 				*corner[0][1][0], *corner[0][1][1],
 				*corner[1][0][0], *corner[1][0][1],
 				*corner[1][1][0], *corner[1][1][1],
-				lambda);
+				lambda, out);
 		}
 		
 		Object interpolate8 (
@@ -885,10 +1157,10 @@ namespace volume {
 			const Object& c010, const Object& c011,
 			const Object& c100, const Object& c101,
 			const Object& c110, const Object& c111, const double lambda[3]) const {
-			return interpolate2(
-					interpolate4(c000, c001, c010, c011, lambda),
-					interpolate4(c100, c101, c110, c111, lambda),
-					lambda[2]);
+			Object out;
+			TrilinearInterpolation<Object>::interpolate8(
+				c000, c001, c010, c011, c100, c101, c110, c111, lambda, out);
+			return out;
 		}
 		
 		Object interpolate4 (
@@ -917,7 +1189,7 @@ namespace volume {
 			}
 			cout << "change the volume from " << input;
 			cout << " to " << output << " ... " << flush;
-			clock_t t1 = clock();
+			ScopedTimer timer("Volume::changeOrientation");
 			
 			// compute the orientation mapping
 			int mapping[3];
@@ -954,8 +1226,7 @@ namespace volume {
 			deallocate(old_voxel, old_size);
 			// object-specific orientation mapping
 			objectSpecificOrientationMapping(mapping, dir);
-			clock_t t2 = clock();
-			cout << "Done in " << (t2 - t1)/(double)CLOCKS_PER_SEC << 's' << endl;
+			cout << "Done in " << timer.elapsed() << 's' << endl;
 			setName(getFilenameForSymTensor3DVolumeDerived(this->name.c_str(),output));
 		}
 		
@@ -996,18 +1267,14 @@ namespace volume {
 			// set up nifti image structure
 			nifti_image *nim = toNifti(filename, dim, intent_code);
 			
-			//cout << "Converting the buffer ... " << flush;
-			clock_t t1 = clock();
 			convertVectorialVoxelToNiftiData<float>(nim, dim);
-			clock_t t2 = clock();
-			//cout << "Done in " << (t2 - t1)/(double)CLOCKS_PER_SEC << 's' << endl;
 			
 			// write nifti and clean up
 			cout << "Writing " << filename <<  " ... " << flush;
-			t1 = clock();
+			ScopedTimer timer("Volume::writeNifti");
 			nifti_image_write(nim);
-			t2 = clock();
-			cout << "Done in " << (t2 - t1)/(double)CLOCKS_PER_SEC << 's' << endl;
+			timer.addBytes((unsigned long long)nim->nvox * nim->nbyper);
+			cout << "Done in " << timer.elapsed() << 's' << endl;
 			nifti_image_free(nim);
 			return true;
 		}
@@ -1016,18 +1283,14 @@ namespace volume {
 			// set up nifti image structure
 			nifti_image *nim = toNifti(filename, 1, intent_code);
 			
-			//cout << "Converting the buffer ... " << flush;
-			clock_t t1 = clock();
 			convertScalarVoxelToNiftiData<float>(nim);
-			clock_t t2 = clock();
-			//cout << "Done in " << (t2 - t1)/(double)CLOCKS_PER_SEC << 's' << endl;
 			
 			// write nifti and clean up
 			cout << "Writing " << filename << " ... " << flush;
-			t1 = clock();
+			ScopedTimer timer("Volume::writeNifti");
 			nifti_image_write(nim);
-			t2 = clock();
-			cout << "Done in " << (t2 - t1)/(double)CLOCKS_PER_SEC << 's' << endl;
+			timer.addBytes((unsigned long long)nim->nvox * nim->nbyper);
+			cout << "Done in " << timer.elapsed() << 's' << endl;
 			nifti_image_free(nim);
 			return true;
 		}
@@ -1290,10 +1553,12 @@ namespace volume {
 		nifti_image *readNiftiCommon (const char *filename, const int dim, const int intent_code) {
 			// read nifti file
 			cout << "Reading " << filename << " ... " << flush;
-			clock_t t1 = clock();
+			ScopedTimer timer("Volume::readNifti");
 			nifti_image *nim = fromNifti(filename, dim, intent_code);
-			clock_t t2 = clock();
-			cout << "Done in " << (t2 - t1)/(double)CLOCKS_PER_SEC << 's' << endl;
+			if (nim != NULL) {
+				timer.addBytes((unsigned long long)nim->nvox * nim->nbyper);
+			}
+			cout << "Done in " << timer.elapsed() << 's' << endl;
 			return nim;
 		}
 		
@@ -1313,6 +1578,9 @@ namespace volume {
 		virtual void exp () {};
 	};
 	
+	template <class Object>
+	bool Volume<Object>::GradientOnDemand = false;
+	
 }
 
 #endif
@@ -47,6 +47,9 @@ namespace volume {
 		VolumeTestStatistics (const char *group1, const char *group2, const char *mask);
 		virtual ~VolumeTestStatistics () {};
 		void printHypothesesIndex () const;
+		const vector< vector<int> >& getHypothesesIndex () const {
+			return hypothesesIndex;
+		}
 		void mapTestStatisticsToVolume (const char *output, const vector<double>& testStats) const;
 	};
 }
@@ -100,6 +100,356 @@ fi
 #
 dtitk_qsub="qsub ${DTITK_QSUB_QUEUE}"
 
+#
+# local job pool
+#
+# with DTITK_USE_LOCAL=1, the per-subject jobs are run in parallel on
+# the local host instead of being submitted with qsub.  a job starts as
+# soon as one of the workers is free and its memory fits.  the number
+# of workers is DTITK_LOCAL_JOBS, by default the number of cores, and
+# the cores are shared out between them through OMP_NUM_THREADS, unless
+# already set.
+#
+# every job is submitted with its predicted peak memory in MB, see
+# dtitk_predict_memory, or DTITK_LOCAL_JOB_MEMORY when not given.  a job
+# is only started while the predictions of the running jobs and its own
+# add up to no more than DTITK_LOCAL_MEMORY (in MB), by default the
+# memory available when the first job is submitted.  a job larger than
+# the budget runs on its own.
+#
+# a failed job is retried DTITK_LOCAL_RETRIES times (1 by default).  a
+# completed job leaves a marker in DTITK_LOCAL_STATE (dtitk_local_state
+# by default), keyed on the command and on the content of the input
+# files given with -in; with DTITK_LOCAL_RESUME=1, the jobs with a
+# marker are skipped, so an interrupted run can be restarted with the
+# same command and picks up where it stopped.  a job without -in
+# inputs is never skipped: only the per-subject registrations of the
+# *_sn scripts and the warps of dti_warp_to_template_group are resumed
+# this way.  the population scripts update the affines of the subjects
+# in place and resume whole iterations instead, see
+# dtitk_local_iteration_done.
+#
+# usage:
+#   dtitk_local_submit [-mem MB] [-in file]... stdout stderr command [arguments]
+#   dtitk_local_wait
+#
+
+# DTITK_USE_LOCAL flag
+if [ -z "${DTITK_USE_LOCAL}" ]
+then
+	export DTITK_USE_LOCAL=0
+fi
+
+# DTITK_LOCAL_RESUME flag
+if [ -z "${DTITK_LOCAL_RESUME}" ]
+then
+	export DTITK_LOCAL_RESUME=0
+fi
+
+if [ -z "${DTITK_LOCAL_RETRIES}" ]
+then
+	export DTITK_LOCAL_RETRIES=1
+fi
+
+if [ -z "${DTITK_LOCAL_STATE}" ]
+then
+	export DTITK_LOCAL_STATE=dtitk_local_state
+fi
+
+dtitk_local_workers=""
+dtitk_local_budget=""
+dtitk_local_pids=""
+dtitk_local_mems=""
+dtitk_local_failed=0
+dtitk_local_used=0
+
+function dtitk_local_cores {
+if [ -r /proc/cpuinfo ]
+then
+	grep -c ^processor /proc/cpuinfo
+else
+	sysctl -n hw.ncpu 2> /dev/null || echo 1
+fi
+}
+
+# the available memory in MB, empty if unknown
+function dtitk_local_memory {
+if [ -r /proc/meminfo ]
+then
+	awk '/^MemAvailable:/ { print int($2 / 1024) }' /proc/meminfo
+fi
+}
+
+function dtitk_local_init {
+local cores=`dtitk_local_cores`
+local workers=${DTITK_LOCAL_JOBS}
+if [ -z "${workers}" ]
+then
+	workers=${cores}
+fi
+if [ ${workers} -lt 1 ]
+then
+	workers=1
+fi
+dtitk_local_workers=${workers}
+dtitk_local_budget=${DTITK_LOCAL_MEMORY}
+if [ -z "${dtitk_local_budget}" ]
+then
+	dtitk_local_budget=`dtitk_local_memory`
+fi
+if [ -z "${OMP_NUM_THREADS}" ]
+then
+	local threads
+	let threads=cores/workers
+	if [ ${threads} -lt 1 ]
+	then
+		threads=1
+	fi
+	export OMP_NUM_THREADS=${threads}
+fi
+mkdir -p ${DTITK_LOCAL_STATE}
+echo "running up to ${dtitk_local_workers} local jobs with ${OMP_NUM_THREADS} threads each"
+if [ -n "${dtitk_local_budget}" ]
+then
+	echo "within a memory budget of ${dtitk_local_budget} MB"
+fi
+}
+
+# collect the finished jobs
+function dtitk_local_reap {
+local running=""
+local mems=""
+local used=0
+local pid
+local mem
+set -- ${dtitk_local_mems}
+for pid in ${dtitk_local_pids}
+do
+	mem=$1
+	shift
+	if kill -0 ${pid} 2> /dev/null
+	then
+		running="${running} ${pid}"
+		mems="${mems} ${mem}"
+		let used=used+mem
+	else
+		wait ${pid}
+		if [ $? -ne 0 ]
+		then
+			let dtitk_local_failed=dtitk_local_failed+1
+		fi
+	fi
+done
+dtitk_local_pids=${running}
+dtitk_local_mems=${mems}
+dtitk_local_used=${used}
+}
+
+# whether a job of the given memory can start now
+function dtitk_local_admit {
+set -- ${dtitk_local_pids}
+if [ $# -eq 0 ]
+then
+	return 0
+fi
+if [ $# -ge ${dtitk_local_workers} ]
+then
+	return 1
+fi
+if [ -n "${dtitk_local_budget}" ]
+then
+	local total
+	let total=dtitk_local_used+$1
+	if [ ${total} -gt ${dtitk_local_budget} ]
+	then
+		return 1
+	fi
+fi
+return 0
+}
+
+# the key of a job: the cksum of the command and of the content of the
+# given input files
+function dtitk_local_key {
+local job=$1
+shift
+( echo "${job}"; cat "$@" ) | cksum | awk '{ print $1 "_" $2 }'
+}
+
+function dtitk_local_submit {
+local mem=${DTITK_LOCAL_JOB_MEMORY}
+local inputs=""
+while [ "$1" == "-mem" ] || [ "$1" == "-in" ]
+do
+	if [ "$1" == "-mem" ]
+	then
+		mem=$2
+	else
+		inputs="${inputs} $2"
+	fi
+	shift 2
+done
+if [ -z "${mem}" ]
+then
+	mem=0
+fi
+if [ $# -lt 3 ]
+then
+	echo "Usage: dtitk_local_submit [-mem MB] [-in file]... stdout stderr command [arguments]"
+	exit 1
+fi
+local out=$1
+local err=$2
+shift 2
+local job="$*"
+if [ -z "${dtitk_local_workers}" ]
+then
+	dtitk_local_init
+fi
+local key=`dtitk_local_key "${job}" ${inputs}`
+local marker=${DTITK_LOCAL_STATE}/${key}.done
+if [ -f ${marker} ]
+then
+	if [ "${DTITK_LOCAL_RESUME}" -eq 1 ] && [ -n "${inputs}" ]
+	then
+		echo "skipping the completed job: ${job}"
+		return 0
+	fi
+	rm -f ${marker}
+fi
+if [ -n "${dtitk_local_budget}" ] && [ ${mem} -gt ${dtitk_local_budget} ]
+then
+	echo "predicted ${mem} MB exceeds the memory budget, running on its own: ${job}"
+fi
+# wait for a free worker and enough memory
+dtitk_local_reap
+until dtitk_local_admit ${mem}
+do
+	sleep 1
+	dtitk_local_reap
+done
+(
+	local attempt=0
+	until eval "${job}" > ${out} 2> ${err}
+	do
+		let attempt=attempt+1
+		if [ ${attempt} -gt ${DTITK_LOCAL_RETRIES} ]
+		then
+			echo "job failed: ${job}"
+			exit 1
+		fi
+		echo "retrying the failed job: ${job}"
+	done
+	echo "${job}" > ${marker}
+) &
+dtitk_local_pids="${dtitk_local_pids} $!"
+dtitk_local_mems="${dtitk_local_mems} ${mem}"
+let dtitk_local_used=dtitk_local_used+mem
+}
+
+# wait for all the submitted jobs, failing if any of them failed
+function dtitk_local_wait {
+dtitk_local_reap
+while [ -n "${dtitk_local_pids}" ]
+do
+	sleep 1
+	dtitk_local_reap
+done
+if [ ${dtitk_local_failed} -ne 0 ]
+then
+	echo "${dtitk_local_failed} local job(s) failed"
+	dtitk_local_failed=0
+	return 1
+fi
+return 0
+}
+
+# the iterations of the population scripts: an iteration completed with
+# the same arguments and initial template is skipped when resuming, as
+# long as its mean is still there.  an interrupted iteration is run
+# again from its start, with the resume of its jobs turned off, since
+# it may already have composed some of the affines in place.
+#   dtitk_local_iteration_reset name key
+#   dtitk_local_iteration_done name key iteration mean
+#   dtitk_local_iteration_mark name key iteration
+function dtitk_local_iteration_reset {
+if [ "${DTITK_LOCAL_RESUME}" -ne 1 ]
+then
+	rm -f ${DTITK_LOCAL_STATE}/$1_$2_*.done
+fi
+}
+
+function dtitk_local_iteration_done {
+if [ "${DTITK_USE_LOCAL}" -ne 1 ] || [ "${DTITK_LOCAL_RESUME}" -ne 1 ]
+then
+	return 1
+fi
+[ -f ${DTITK_LOCAL_STATE}/$1_$2_$3.done ] && [ -f $4 ]
+}
+
+function dtitk_local_iteration_mark {
+if [ "${DTITK_USE_LOCAL}" -eq 1 ]
+then
+	mkdir -p ${DTITK_LOCAL_STATE}
+	echo "$1 iteration $3" > ${DTITK_LOCAL_STATE}/$1_$2_$3.done
+fi
+}
+
+# the voxels and the voxel size of a volume, as "xsize ysize zsize xv yv zv"
+function dtitk_volume_size {
+VolumeInfo $1 2> /dev/null | sed -n -e 's/^size: \([0-9]*\)x\([0-9]*\)x\([0-9]*\), voxel size: \([^x]*\)x\([^x]*\)x\([^,]*\),.*/\1 \2 \3 \4 \5 \6/p'
+}
+
+#
+# the predicted peak memory in MB of a per-subject job, from the sizes
+# of its volumes: the tensors are held in double, 48 bytes per voxel,
+# the masks in 8 and the deformation fields in 24.  this is the only
+# memory model, the tools themselves do not predict their memory
+#   rigid, affine: target and subject at full resolution and the target
+#                  at the separation sep, with its three gradients
+#   diffeo:        target with its three gradients, subject, warped
+#                  subject and mask at the target resolution
+#   warp:          subject, its deformation field and the output at the
+#                  target resolution
+#   resample:      subject and the output at the target resolution
+#
+function dtitk_predict_memory {
+if [ $# -lt 3 ]
+then
+	echo "Usage: dtitk_predict_memory rigid|affine|diffeo|warp|resample target subject [sep]"
+	exit 1
+fi
+local target=`dtitk_volume_size $2`
+local subject=`dtitk_volume_size $3`
+if [ -z "${target}" ] || [ -z "${subject}" ]
+then
+	echo ${DTITK_LOCAL_JOB_MEMORY:-0}
+	return 0
+fi
+echo ${target} ${subject} ${4:-0} | awk -v kind=$1 '{
+	nt = $1 * $2 * $3
+	ns = $7 * $8 * $9
+	nsep = nt
+	if ($13 > 0) {
+		f = $4 * $5 * $6 / ($13 * $13 * $13)
+		if (f < 1) {
+			nsep = nt * f
+		}
+	}
+	if (kind == "rigid" || kind == "affine") {
+		bytes = (nt + ns) * 48 + nsep * 4 * 48
+	} else if (kind == "diffeo") {
+		bytes = nt * (4 * 48 + 48 + 48 + 8)
+	} else if (kind == "warp") {
+		bytes = ns * (48 + 24) + nt * 48
+	} else {
+		bytes = (nt + ns) * 48
+	}
+	# and the process itself
+	printf "%d\n", bytes / 1048576 + 64
+}'
+}
+
 ## the multi-iteration starting levels for deformable registration
 ## the first element is just buffer, not used!
 start=( 0  2     3     3     4     4     5     )
@@ -0,0 +1,154 @@
+/*============================================================================
+
+  Program:     DTI ToolKit (DTI-TK)
+  Module:      $RCSfile: kernelBenchmark.cpp,v $
+  Language:    C++
+  Date:        $Date: 2026/10/18 21:12:05 $
+  Version:     $Revision: 1.1 $
+
+  Copyright (c) Gary Hui Zhang (garyhuizhang@gmail.com).
+  All rights reserverd.
+
+  DTI-TK is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  DTI-TK is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with DTI-TK.  If not, see <http://www.gnu.org/licenses/>.
+============================================================================*/
+
+// kernelBenchmark
+//
+// times the kernels of KernelBenchmark and writes the report, as JSON
+// if the output name ends in .json and as CSV otherwise:
+//
+//   kernelBenchmark -sizes 64x64x64,128x128x128 -threads 1,4 -out run.csv
+//
+// with -baseline, the results are compared with a CSV report of an
+// earlier run, the slower kernels and those whose checksum changed are
+// printed, and the exit code is 1 if there are any.  the transformations
+// are drawn from -seed, so the checksums only compare between runs of
+// the same seed.
+
+#include "../include/benchmark/KernelBenchmark.h"
+#include "../include/io/strOption.h"
+#include "../include/io/intOption.h"
+#include "../include/io/dblOption.h"
+#include <cstdlib>
+#include <sstream>
+
+using namespace std;
+using namespace io;
+using namespace benchmark;
+
+// the items of a comma separated list
+vector<string> splitList (const string& in) {
+	vector<string> items;
+	istringstream iss(in);
+	string item;
+	while (getline(iss, item, ',')) {
+		if (!item.empty()) {
+			items.push_back(item);
+		}
+	}
+	return items;
+}
+
+int main (int argc, char *argv[]) {
+	strOption sizes("-sizes");
+	sizes.description = "the volume sizes, e.g. 64x64x64,128x128x128";
+	strOption threads("-threads");
+	threads.description = "the thread counts, e.g. 1,2,4";
+	intOption repeats("-repeats");
+	repeats.description = "the number of timed runs of each kernel";
+	intOption points("-points");
+	points.description = "the number of points sampled by the interpolation kernels";
+	intOption seed("-seed");
+	seed.description = "the seed of the random transformations";
+	strOption tmp("-tmp");
+	tmp.description = "where the nifti kernels write their file";
+	strOption out("-out");
+	out.inputRequired = true;
+	out.description = "the report, as JSON if the name ends in .json and as CSV otherwise";
+	strOption baseline("-baseline");
+	baseline.description = "a CSV report of an earlier run to compare with";
+	dblOption tolerance("-tolerance");
+	tolerance.description = "the relative slowdown reported as a regression, 0.1 by default";
+	vector<option*> options;
+	options.push_back(&sizes);
+	options.push_back(&threads);
+	options.push_back(&repeats);
+	options.push_back(&points);
+	options.push_back(&seed);
+	options.push_back(&tmp);
+	options.push_back(&out);
+	options.push_back(&baseline);
+	options.push_back(&tolerance);
+	option::parseOptions(argc, argv, options);
+	
+	KernelBenchmark bench;
+	if (sizes.inputFound) {
+		const vector<string> items = splitList(sizes.getValue());
+		for (size_t i = 0; i < items.size(); ++i) {
+			int sz[3];
+			char x1, x2;
+			istringstream iss(items[i]);
+			if (!(iss >> sz[0] >> x1 >> sz[1] >> x2 >> sz[2]) || x1 != 'x' || x2 != 'x' || sz[0] < 1 || sz[1] < 1 || sz[2] < 1) {
+				cerr << "invalid size " << items[i] << endl;
+				exit(1);
+			}
+			bench.addSize(sz);
+		}
+	}
+	if (threads.inputFound) {
+		const vector<string> items = splitList(threads.getValue());
+		for (size_t i = 0; i < items.size(); ++i) {
+			const int n = atoi(items[i].c_str());
+			if (n < 1) {
+				cerr << "invalid thread count " << items[i] << endl;
+				exit(1);
+			}
+			bench.addThreads(n);
+		}
+	}
+	if (repeats.inputFound) {
+		bench.setRepeats(repeats.var[0]);
+	}
+	if (points.inputFound) {
+		bench.setNoOfPoints(points.var[0]);
+	}
+	if (seed.inputFound) {
+		bench.setSeed(seed.var[0]);
+	}
+	if (tmp.inputFound) {
+		bench.setTemporaryDirectory(tmp.c_str());
+	}
+	
+	BenchmarkReport report;
+	bench.run(report);
+	
+	const string filename = out.getValue();
+	const bool json = filename.size() >= 5 && filename.compare(filename.size() - 5, 5, ".json") == 0;
+	if (!(json ? report.writeJSON(filename.c_str()) : report.writeCSV(filename.c_str()))) {
+		cerr << "cannot write " << filename << endl;
+		exit(1);
+	}
+	
+	if (baseline.inputFound) {
+		BenchmarkReport base;
+		if (!base.readCSV(baseline.c_str())) {
+			cerr << "cannot read " << baseline.getValue() << endl;
+			exit(1);
+		}
+		const double timeTolerance = tolerance.inputFound ? tolerance.var[0] : 0.1;
+		const int regressions = report.compareWith(base, timeTolerance, 1e-6, cout);
+		return regressions > 0 ? 1 : 0;
+	}
+	return 0;
+}
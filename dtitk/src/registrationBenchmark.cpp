@@ -0,0 +1,172 @@
+/*============================================================================
+
+  Program:     DTI ToolKit (DTI-TK)
+  Module:      $RCSfile: registrationBenchmark.cpp,v $
+  Language:    C++
+  Date:        $Date: 2026/10/19 10:42:17 $
+  Version:     $Revision: 1.1 $
+
+  Copyright (c) Gary Hui Zhang (garyhuizhang@gmail.com).
+  All rights reserverd.
+
+  DTI-TK is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  DTI-TK is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with DTI-TK.  If not, see <http://www.gnu.org/licenses/>.
+============================================================================*/
+
+// registrationBenchmark
+//
+// runs RegistrationBenchmark in the work directory and writes the
+// results, as JSON if the output name ends in .json and as CSV
+// otherwise:
+//
+//   registrationBenchmark -dir /tmp/bench -env OMP_NUM_THREADS=4 -label omp4 -out omp4.csv
+//
+// without -template, a synthetic template and its mask are written to
+// the work directory.  the results are written even if some stages
+// failed; the exit code is then 1.
+
+#include "../include/benchmark/RegistrationBenchmark.h"
+#include "../include/io/strOption.h"
+#include "../include/io/intOption.h"
+#include "../include/io/dblOption.h"
+#include <cstdlib>
+#include <sstream>
+
+using namespace std;
+using namespace io;
+using namespace benchmark;
+
+// the items of a comma separated list
+vector<string> splitList (const string& in) {
+	vector<string> items;
+	istringstream iss(in);
+	string item;
+	while (getline(iss, item, ',')) {
+		if (!item.empty()) {
+			items.push_back(item);
+		}
+	}
+	return items;
+}
+
+int main (int argc, char *argv[]) {
+	strOption dir("-dir");
+	dir.inputRequired = true;
+	dir.description = "the existing work directory of the registrations";
+	strOption tmpl("-template");
+	tmpl.description = "the template, synthetic if not given";
+	strOption mask("-mask");
+	mask.description = "the mask of the template, required with -template";
+	strOption label("-label");
+	label.description = "the name of the configuration in the results";
+	strOption env("-env");
+	env.description = "the environment of the scripts, e.g. OMP_NUM_THREADS=4,DTITK_USE_QSUB=0";
+	strOption sm("-sm");
+	sm.description = "the similarity measure, EDS by default";
+	dblOption sep("-sep", 3);
+	sep.description = "the sampling separation in mm, 4 4 4 by default";
+	dblOption ftol("-ftol");
+	ftol.description = "the tolerance of the optimizers, 0.01 by default";
+	intOption iters("-iters");
+	iters.description = "the number of diffeomorphic iterations, 6 by default";
+	intOption subjects("-subjects");
+	subjects.description = "the number of synthetic subjects, 4 by default";
+	intOption seed("-seed");
+	seed.description = "the seed of the ground truth transformations";
+	dblOption fa("-fa");
+	fa.description = "the FA threshold of the tensor similarities, 0.2 by default";
+	dblOption magnitude("-magnitude", 2);
+	magnitude.description = "the magnitude of the affine and of the deformation, 1 1 by default";
+	strOption out("-out");
+	out.inputRequired = true;
+	out.description = "the results, as JSON if the name ends in .json and as CSV otherwise";
+	vector<option*> options;
+	options.push_back(&dir);
+	options.push_back(&tmpl);
+	options.push_back(&mask);
+	options.push_back(&label);
+	options.push_back(&env);
+	options.push_back(&sm);
+	options.push_back(&sep);
+	options.push_back(&ftol);
+	options.push_back(&iters);
+	options.push_back(&subjects);
+	options.push_back(&seed);
+	options.push_back(&fa);
+	options.push_back(&magnitude);
+	options.push_back(&out);
+	option::parseOptions(argc, argv, options);
+	
+	RegistrationBenchmark bench(dir.c_str());
+	if (tmpl.inputFound) {
+		if (!mask.inputFound) {
+			cerr << "-template requires -mask" << endl;
+			exit(1);
+		}
+		bench.setTemplate(tmpl.c_str(), mask.c_str());
+	}
+	if (label.inputFound) {
+		bench.setLabel(label.c_str());
+	}
+	if (env.inputFound) {
+		const vector<string> items = splitList(env.getValue());
+		for (size_t i = 0; i < items.size(); ++i) {
+			const size_t eq = items[i].find('=');
+			if (eq == string::npos || eq == 0) {
+				cerr << "invalid environment variable " << items[i] << endl;
+				exit(1);
+			}
+			bench.setEnvironment(items[i].substr(0, eq).c_str(), items[i].substr(eq + 1).c_str());
+		}
+	}
+	if (sm.inputFound) {
+		bench.setSMOption(sm.c_str());
+	}
+	if (sep.inputFound) {
+		const double in[3] = {sep.var[0], sep.var[1], sep.var[2]};
+		bench.setSeparation(in);
+	}
+	if (ftol.inputFound) {
+		bench.setFTol(ftol.var[0]);
+	}
+	if (iters.inputFound) {
+		bench.setNoOfDiffeomorphicIterations(iters.var[0]);
+	}
+	if (subjects.inputFound) {
+		bench.setNoOfSubjects(subjects.var[0]);
+	}
+	if (seed.inputFound) {
+		bench.setSeed(seed.var[0]);
+	}
+	if (fa.inputFound) {
+		bench.setFAThreshold(fa.var[0]);
+	}
+	if (magnitude.inputFound) {
+		bench.setMagnitude(magnitude.var[0], magnitude.var[1]);
+	}
+	
+	bench.run();
+	
+	const string filename = out.getValue();
+	const bool json = filename.size() >= 5 && filename.compare(filename.size() - 5, 5, ".json") == 0;
+	if (!(json ? bench.writeJSON(filename.c_str()) : bench.writeCSV(filename.c_str()))) {
+		exit(1);
+	}
+	
+	const int failures = bench.getNoOfFailures();
+	if (failures > 0) {
+		cerr << failures << " registration stages failed" << endl;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,217 @@
+"""This module caches the outputs of the pipeline steps run with external tools.
+
+    A step is one command (e.g. `eddy`, `fsl_to_dtitk`, `dti_affine_reg`). Its
+    key is a SHA-256 hash of:
+
+    1. the command and its arguments,
+    2. the content of the tool's executable (or script), standing in for its
+       version, and of the programs it runs: a DTI-TK script (e.g.
+       `dti_affine_reg`) runs the binaries in `bin` and the other scripts of
+       its install, and FSL's `bet` and `eddy` are wrappers (see
+       `WRAPPED_TOOLS`),
+    3. the content of its input files.
+
+    After a successful run, the output files are stored in a
+    content-addressed directory (`objects/<hash of the file>`) and the key is
+    mapped to them (`steps/<key>.json`). When the same step is run again with
+    the same inputs, the outputs are copied back instead of running the tool.
+    So after a change of parameter (e.g. `NUM_DIFFEO_ITERS`) or of input data
+    (e.g. `BEST_POPULATION_SUBSET`), only the steps whose command or inputs
+    changed are run again.
+
+    The cache is enabled by setting `config.STEP_CACHE_DIR`.
+"""
+
+
+import os
+import json
+import glob
+import shutil
+import hashlib
+import subprocess
+from pathlib import Path
+from typing import Union
+from pgimri.utils import get_logger
+from pgimri.parallel import run_command
+from pgimri.config import *
+
+
+__all__ = [
+    "StepCache", "run_cached", "hash_file"
+]
+
+logger = get_logger(__name__)
+
+# (path, size, modification time) -> content hash of the files already hashed
+_FILE_HASHES = {}
+
+# Wrapper scripts -> the programs they run, which are hashed along with them
+WRAPPED_TOOLS = {
+    "bet": ["bet2"],
+    "eddy": ["eddy_cpu", "eddy_openmp"],
+}
+
+
+def hash_file(path: Union[str, Path]) -> str:
+    """SHA-256 of the content of a file, remembered until the file changes."""
+    path = os.path.abspath(path)
+    stat = os.stat(path)
+    memo_key = (path, stat.st_size, stat.st_mtime_ns)
+    if memo_key not in _FILE_HASHES:
+        sha = hashlib.sha256()
+        with open(path, "rb") as f:
+            for chunk in iter(lambda: f.read(1 << 20), b""):
+                sha.update(chunk)
+        _FILE_HASHES[memo_key] = sha.hexdigest()
+    return _FILE_HASHES[memo_key]
+
+
+def _tool_files(name: str) -> list:
+    """The executable of a tool and of the programs it runs, sorted."""
+    tool = shutil.which(name)
+    if tool is None:
+        return []
+    files = {os.path.realpath(tool)}
+    for wrapped in WRAPPED_TOOLS.get(os.path.basename(name), []):
+        wrapped = shutil.which(wrapped)
+        if wrapped is not None:
+            files.add(os.path.realpath(wrapped))
+    # A DTI-TK script (in `$DTITK_ROOT/scripts`) runs the binaries of the
+    # install and its other scripts
+    folder = os.path.dirname(os.path.realpath(tool))
+    dtitk_bin = os.path.join(os.path.dirname(folder), "bin")
+    if os.path.basename(folder) == "scripts" and os.path.isdir(dtitk_bin):
+        for path in glob.glob(f"{dtitk_bin}/*") + glob.glob(f"{folder}/*"):
+            if os.path.isfile(path):
+                files.add(os.path.realpath(path))
+    return sorted(files)
+
+
+def _missing(patterns: list) -> list:
+    """The paths that do not exist and the glob patterns matching no file."""
+    missing = []
+    for pattern in patterns:
+        pattern = str(pattern)
+        if glob.has_magic(pattern):
+            if not any(os.path.isfile(p) for p in glob.glob(pattern)):
+                missing.append(pattern)
+        elif not os.path.isfile(pattern):
+            missing.append(pattern)
+    return missing
+
+
+def _expand(patterns: list) -> list:
+    """Existing files matching the given paths or glob patterns, sorted."""
+    files = set()
+    for pattern in patterns:
+        files.update(p for p in glob.glob(str(pattern)) if os.path.isfile(p))
+    return sorted(os.path.abspath(p) for p in files)
+
+
+class StepCache:
+    """Content-addressed cache of the outputs of the pipeline steps.
+
+        Args:
+            cache_dir: folder where the outputs are stored.
+
+        Example:
+
+            .. code-block:: python
+
+                cache = StepCache("~/.cache/pgimri")
+                cache.run(["TVMean", "-in", "subs.txt", "-out", "mean.nii.gz"],
+                          inputs=["subs.txt", "sub1.nii.gz", "sub2.nii.gz"],
+                          outputs=["mean.nii.gz"])
+    """
+
+    def __init__(self, cache_dir: Union[str, Path]) -> None:
+        self.cache_dir = Path(cache_dir).expanduser()
+
+    def _object_path(self, digest: str) -> Path:
+        return self.cache_dir/"objects"/digest[:2]/digest
+
+    def _step_path(self, key: str) -> Path:
+        return self.cache_dir/"steps"/f"{key}.json"
+
+    def get_key(self, command: list, inputs: list) -> str:
+        """Key of a step, from its command, tools and input files."""
+        sha = hashlib.sha256()
+        sha.update(json.dumps([str(c) for c in command]).encode())
+        for tool in _tool_files(str(command[0])):
+            sha.update(f"{os.path.basename(tool)}:{hash_file(tool)}".encode())
+        for path in _expand(inputs):
+            sha.update(f"{path}:{hash_file(path)}".encode())
+        return sha.hexdigest()
+
+    def restore(self, key: str) -> bool:
+        """Copy the outputs of a step back, if all of them are cached."""
+        step_path = self._step_path(key)
+        if not step_path.exists():
+            return False
+        with open(step_path) as sf:
+            outputs = json.load(sf)["outputs"]
+        if not all(self._object_path(d).exists() for d in outputs.values()):
+            return False
+        for path, digest in outputs.items():
+            Path(path).parent.mkdir(parents=True, exist_ok=True)
+            shutil.copyfile(self._object_path(digest), path)
+        return True
+
+    def store(self, key: str, command: list, outputs: list) -> None:
+        """Add the outputs of a step to the cache."""
+        entry = {"command": [str(c) for c in command], "outputs": {}}
+        for path in _expand(outputs):
+            digest = hash_file(path)
+            object_path = self._object_path(digest)
+            if not object_path.exists():
+                object_path.parent.mkdir(parents=True, exist_ok=True)
+                tmp_path = object_path.with_name(f"{digest}.{os.getpid()}.tmp")
+                shutil.copyfile(path, tmp_path)
+                os.replace(tmp_path, object_path)
+            entry["outputs"][path] = digest
+        step_path = self._step_path(key)
+        step_path.parent.mkdir(parents=True, exist_ok=True)
+        tmp_path = step_path.with_name(f"{key}.{os.getpid()}.tmp")
+        with open(tmp_path, "w") as sf:
+            json.dump(entry, sf, indent=4)
+        os.replace(tmp_path, step_path)
+
+    def run(self, command: list, inputs: list = [], outputs: list = [],
+            **kwargs) -> subprocess.CompletedProcess:
+        """Run a step, or restore its outputs if it was already run.
+
+        Args:
+            command: the command and its arguments.
+            inputs: paths or glob patterns of the files read by the command.
+            outputs: paths or glob patterns of the files written by the
+                command. They are only cached if every path exists and every
+                pattern matches a file.
+            kwargs: passed to `subprocess.run`.
+
+        Returns:
+            The `subprocess.CompletedProcess` of the command, with exit code 0
+            and no output if restored from the cache.
+        """
+        key = self.get_key(command, inputs)
+        if self.restore(key):
+            logger.info(f"`{command[0]}` inputs unchanged. Restored its outputs from the cache.")
+            return subprocess.CompletedProcess(command, 0)
+        result = run_command(command, **kwargs)
+        if result.returncode == 0:
+            missing = _missing(outputs)
+            if missing:
+                logger.warning(f"`{command[0]}` did not write {missing}. Its outputs are not cached.")
+            else:
+                self.store(key, command, outputs)
+        return result
+
+
+def run_cached(command: list, inputs: list = [], outputs: list = [],
+               **kwargs) -> subprocess.CompletedProcess:
+    """Run a step through the cache in `config.STEP_CACHE_DIR`, or directly
+        with `pgimri.parallel.run_command` if the cache is disabled.
+        See `StepCache.run` for the arguments.
+    """
+    if not STEP_CACHE_DIR:
+        return run_command(command, **kwargs)
+    return StepCache(STEP_CACHE_DIR).run(command, inputs, outputs, **kwargs)
@@ -57,6 +57,28 @@ TEMPLATE_ORIGIN = [-104, 155, 40]
 SUBJ_TO_TEMPLATE_ORIGIN = [-0, -0, -0] # JHU
 
 
+# Parallel processing of multiple subjects
+# Number of subjects processed at the same time. 1 processes them one after
+# the other as before. `None` uses one worker per CPU core.
+NUM_WORKERS = 1
+# Maximum number of concurrent runs of an external tool across all workers.
+# `eddy` and `topup` need a lot of memory and threads. Tools not listed here
+# (e.g. `TVtool`) are not limited.
+STEP_CONCURRENCY = {"eddy": 1, "topup": 2}
+# OpenMP threads given to each worker. `None` shares the CPU cores equally
+# between the workers so that they do not oversubscribe the machine.
+OMP_THREADS_PER_WORKER = None
+# Per-subject status file written in the output folder. Subjects already
+# completed with the same parameters and input files are skipped when an
+# interrupted run is started again.
+MANIFEST_FILENAME = "manifest.json"
+
+# Folder where the outputs of the steps are cached (e.g. "~/.cache/pgimri").
+# A step run again with the same command, tool and input files restores its
+# outputs from the cache instead. `None` disables the cache.
+STEP_CACHE_DIR = None
+
+
 
 # Logging settings, Either CRITICAL, ERROR, WARNING, INFO or DEBUG.
 LOG_FILENAME = "ITC_DTI_processing_logs.log" # Set to `None` if you do not want to create a log file.
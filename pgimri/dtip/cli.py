@@ -9,6 +9,7 @@ from pgimri.dtip.convert import convert_dicom_to_nifti, dtitk_to_fsl_multi
 from pgimri.dtip.locate import locate_data_files
 from pgimri.dtip.generate import *
 from pgimri.dtip.register import *
+from pgimri.config import NUM_WORKERS
 
 rich_traceback_install()  # Pretty traceback
 
@@ -158,7 +159,9 @@ def process(input_path, output_path, nifti_method, strip_skull):
 @click.option("-nm", "--nifti_method", type=click.Choice(['auto', 'dcm2nii', 'dcm2niix', 'dicom2nifti'], case_sensitive=False), default="auto", show_default=True, help="`auto` uses dcm2niix and dcm2nii to get best data and metadata. `dcm2niix` is Mricron's subpackage. `dcm2nii` is the previous version of dcm2niix. `dicom2nifti` is python package.")
 @click.option('--strip_skull/--no-strip_skull', default=True, show_default=True, help="Perform skull stripping on DTI data. This step will be performed on eddy corrected DTI data.")
 @click.option("-ex", "--exclude", type=str, default='', show_default=True, help="pass a .txt file with the subject names you do not want to process in the given folder. Add one subject name per line.")
-def process_multi(input_path, output_path, nifti_method, strip_skull, exclude):
+@click.option("-j", "--num_workers", type=int, default=NUM_WORKERS, show_default=True, help="number of subjects processed at the same time. 0 uses one worker per CPU core.")
+@click.option('--resume/--no-resume', default=True, show_default=True, help="skip the subjects completed by a previous run (see the manifest in the output folder).")
+def process_multi(input_path, output_path, nifti_method, strip_skull, exclude, num_workers, resume):
     """Perform DTI processing on multiple subjects.
 
         INPUT_PATH - path to subjects folder containing each subjects DICOM data in a folder or zip file.
@@ -173,7 +176,9 @@ def process_multi(input_path, output_path, nifti_method, strip_skull, exclude):
     process_multi_subjects(input_path, output_path,
                            nifti_method=nifti_method,
                            strip_skull=strip_skull,
-                           exclude_list=exclude_list)
+                           exclude_list=exclude_list,
+                           num_workers=num_workers or None,
+                           resume=resume)
 
     # click.echo(click.format_filename(input_path))
 
@@ -203,7 +208,9 @@ def register_pop_multi(input_path: str, output_path: str):
 @click.argument('template_path', type=click.Path(exists=True))
 @click.option('-mit', '--mean_initial_template_path', type=click.Path(exists=True), default=None, show_default=True)
 @click.option('-o', '--output_path', default='./register_output', show_default=True, help="path/to/processed/subject_folder")
-def register_multi(input_path: str, template_path: str, mean_initial_template_path: Union[str, None], output_path: str):
+@click.option("-j", "--num_workers", type=int, default=NUM_WORKERS, show_default=True, help="number of subjects registered at the same time. 0 uses one worker per CPU core.")
+@click.option('--resume/--no-resume', default=True, show_default=True, help="skip the alignments completed by a previous run (see the manifest in the output folder).")
+def register_multi(input_path: str, template_path: str, mean_initial_template_path: Union[str, None], output_path: str, num_workers: int, resume: bool):
     """Perform image registeration using existing template on the given subjects using DTI-TK toolkit.
 
     Args:
@@ -215,7 +222,8 @@ def register_multi(input_path: str, template_path: str, mean_initial_template_pa
     Returns:
         exit code 0 on successful execution.
     """
-    ret = dtitk_register_multi(input_path, template_path, mean_initial_template_path, output_path)
+    ret = dtitk_register_multi(input_path, template_path, mean_initial_template_path, output_path,
+                               num_workers=num_workers or None, resume=resume)
     if ret == 0:
         click.echo("Done.")
 
@@ -5,6 +5,8 @@ import dicom2nifti
 from typing import Union, Tuple
 from pathlib import Path
 from pgimri.utils import get_logger, SpinCursor, show_exec_time
+from pgimri.parallel import run_parallel
+from pgimri.cache import run_cached
 from pgimri.config import *
 from rich.progress import track
 
@@ -159,32 +161,62 @@ def method_dicom2nifti(input_path: Union[str, Path],
             return 1
 
 
+def fsl_to_dtitk_one(subject_path: Union[Path, str],
+                     output_path: Union[Path, str]) -> int:
+    """Convert one subject from FSL to DTI-TK specific format and move the
+        converted files to `output_path/<subject name>`.
+
+    Args:
+        subject_path: folder path containing the subject's data.
+        output_path: folder where the subject's folder is created.
+
+    Returns:
+        exit code 0 on completion, the exit code of `fsl_to_dtitk` if it
+        failed.
+    """
+    subject_path, output_path = Path(subject_path), Path(output_path)
+    basename = f"{subject_path}/{PROCESSED_DTI_FILENAME}"
+    result = run_cached(["fsl_to_dtitk", basename],
+                        inputs=[f"{basename}_[LV][123].nii.gz"],
+                        outputs=[f"{basename}_dtitk.nii.gz",
+                                 f"{basename}_dtitk_norm.nii.gz",
+                                 f"{basename}_dtitk_norm_non_outliers.nii.gz"])
+    if result.returncode != 0:
+        logger.error(f"`fsl_to_dtitk` failed for `{subject_path}`.")
+        return result.returncode
+
+    # Move output files to `output_path`
+    move_to = output_path/subject_path.stem
+    move_to.mkdir(parents=True, exist_ok=True)
+    # print("MOVED HERE =", move_to)
+    dtitk_basename = f"{PROCESSED_DTI_FILENAME}_dtitk"
+    for dtitk_filepath in Path(subject_path).glob("*"):
+        if str(dtitk_filepath.stem).startswith(dtitk_basename):
+            # print("FILE =", dtitk_filepath.name)
+            shutil.move(dtitk_filepath, move_to/dtitk_filepath.name)
+    return 0
+
+
 def fsl_to_dtitk_multi(input_path: Union[Path, str],
-                       output_path: Union[Path, str]) -> int:
+                       output_path: Union[Path, str],
+                       num_workers: Union[int, None] = NUM_WORKERS) -> int:
     """Convert FSL to DTI-TK specific format
     Args:
         input_path: folder path containing subjects' data.
+        output_path: folder where the converted subjects are moved.
+        num_workers: number of subjects converted at the same time.
 
     """
     input_path, output_path = Path(input_path), Path(output_path)
 
     subjects = list(Path(input_path).glob("*"))
-    total_subjects = len(subjects)
-    for i, subject_path in enumerate(subjects, start=1):
-        basename = f"{subject_path}/{PROCESSED_DTI_FILENAME}"
-        subprocess.run(["fsl_to_dtitk", basename])
-        logger.info(f"[{i}/{total_subjects}] Converted `{subject_path}`.")
-
-        # Move output files to `output_path`
-        move_to = output_path/subject_path.stem
-        move_to.mkdir(parents=True, exist_ok=True)
-        # print("MOVED HERE =", move_to)
-        dtitk_basename = f"{PROCESSED_DTI_FILENAME}_dtitk"
-        for dtitk_filepath in Path(subject_path).glob("*"):
-            if str(dtitk_filepath.stem).startswith(dtitk_basename):
-                # print("FILE =", dtitk_filepath.name)
-                shutil.move(dtitk_filepath, move_to/dtitk_filepath.name)
-    
+    jobs = {str(subject_path): dict(subject_path=subject_path, output_path=output_path)
+            for subject_path in subjects}
+    failed = run_parallel(fsl_to_dtitk_one, jobs, num_workers=num_workers)
+    if failed:
+        logger.error(f"Conversion failed for {failed}.")
+        return 1
+
     logger.info("Done!")
     return 0 # exit code 0 for successful execution.
 
@@ -198,6 +230,9 @@ def dtitk_to_fsl_multi(input_path: Union[Path, str],
     Args:
         input_path: folder path containing registred files in DTI-TK .nii.gz format.
         output_path: Move the converted files to this location.
+
+    Returns:
+        exit code 0 on completion, 1 if a subject failed to convert.
     """
     if use_type == 'aff':
         filename_ext = '_aff'
@@ -212,20 +247,26 @@ def dtitk_to_fsl_multi(input_path: Union[Path, str],
     subjects = [p for p in Path(input_path).glob("*") if p.is_dir()]
     move_these = ['L1', 'L2', 'L3', 'V1', 'V2', 'V3', 'fa', 'ad', 'rd']
     total_subjects = len(subjects)
+    failed = []
     for i, subject_path in enumerate(subjects, start=1):
         basename = f"{subject_path}/{PROCESSED_DTI_FILENAME}_dtitk{filename_ext}"
 
         # Convert
         registered_filename = f"{basename}.nii.gz"
-        subprocess.run([
+        results = [run_cached([
             'TVEigenSystem', '-in', registered_filename, '-type', 'FSL'
-        ])
-        # fractional anisotropy (FA)
-        subprocess.run(['TVtool', '-in', registered_filename, '-fa'])
-        # axial diffusivity (AD)
-        subprocess.run(['TVtool', '-in', registered_filename, '-ad'])
-        # radial diffusivity (RD)
-        subprocess.run(['TVtool', '-in', registered_filename, '-rd'])
+        ], inputs=[registered_filename],
+           outputs=[f"{basename}_[LV][123].nii.gz"])]
+        # fractional anisotropy (FA), axial (AD) and radial diffusivity (RD)
+        for index in ['fa', 'ad', 'rd']:
+            results.append(
+                run_cached(['TVtool', '-in', registered_filename, f'-{index}'],
+                           inputs=[registered_filename],
+                           outputs=[f"{basename}_{index}.nii.gz"]))
+        if any(result.returncode != 0 for result in results):
+            logger.error(f"[{i}/{total_subjects}] Conversion failed for `{subject_path}`.")
+            failed.append(str(subject_path))
+            continue
         # Move to `output_path`
         savedir = output_path/subject_path.stem
         savedir.mkdir(parents=True, exist_ok=True)
@@ -236,4 +277,7 @@ def dtitk_to_fsl_multi(input_path: Union[Path, str],
 
         logger.info(f"[{i}/{total_subjects}] Converted and moved to `{savedir}`.")
 
+    if failed:
+        logger.error(f"Conversion failed for {failed}.")
+        return 1
     return 0
\ No newline at end of file
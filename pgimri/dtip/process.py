@@ -14,16 +14,17 @@
 """
 
 
-import subprocess
 from typing import Union
 from pathlib import Path
 from rich.traceback import install as rich_traceback_install
 from pgimri.utils import get_logger, SpinCursor
+from pgimri.parallel import run_parallel, SubjectManifest
+from pgimri.cache import run_cached
 from pgimri.dtip.extract import extract_subject
 from pgimri.dtip.convert import convert_dicom_to_nifti
 from pgimri.dtip.locate import locate_data_files
 from pgimri.dtip.generate import *
-from pgimri.config import PROCESSED_DTI_FILENAME
+from pgimri.config import PROCESSED_DTI_FILENAME, NUM_WORKERS, MANIFEST_FILENAME
 
 
 __all__ = [
@@ -34,6 +35,35 @@ __all__ = [
 rich_traceback_install()  # For better trackback display
 logger = get_logger(__name__)
 
+# Files written by eddy with the options of `run_eddy` (--repol and
+# --estimate_move_by_susceptibility), besides the corrected image
+EDDY_OUTPUT_SUFFIXES = [
+    "parameters", "rotated_bvecs", "movement_rms", "restricted_movement_rms",
+    "post_eddy_shell_alignment_parameters",
+    "post_eddy_shell_PE_translation_parameters",
+    "outlier_report", "outlier_map", "outlier_n_stdev_map",
+    "outlier_n_sqr_stdev_map", "outlier_free_data.nii.gz",
+    "mbs_first_order_fields.nii.gz", "command_txt",
+    "values_of_all_input_parameters"
+]
+
+# Maps written by dtifit (not the DTI-TK files made later from them)
+DTIFIT_OUTPUT_NAMES = [
+    "FA", "MD", "MO", "S0", "L1", "L2", "L3", "V1", "V2", "V3"
+]
+
+
+def _image_files(path: Union[str, Path]) -> list:
+    """Files of a NIfTI image given with or without extension, as FSL does.
+        Without extension, a glob pattern matching `.nii.gz` or `.nii`, so
+        that the image is found whichever of them the tool wrote.
+    """
+    path = str(path)
+    if path.endswith((".nii.gz", ".nii")):
+        return [path]
+    return [f"{path}.nii*"]
+
+
 def dwi_denoise(input_path: Union[str, Path], output_path: Union[str, Path]):
     """This runs MRtrix3's dwidenoise command to remove noise from DWI data.
     
@@ -44,11 +74,12 @@ def dwi_denoise(input_path: Union[str, Path], output_path: Union[str, Path]):
         output_path: path/to/save/DTI_data.nii.gz.
 
     Returns:
-        exit code 0 if successfully executed.
+        exit code of the command, 0 if successfully executed.
     """
 
-    subprocess.run(["dwidenoise", input_path, output_path])
-    return 0
+    result = run_cached(["dwidenoise", input_path, output_path],
+                        inputs=[input_path], outputs=[output_path])
+    return result.returncode
 
 
 def dti_skull_strip(input_path: Union[str, Path], 
@@ -63,16 +94,17 @@ def dti_skull_strip(input_path: Union[str, Path],
             smaller values give larger brain outline estimates
 
     Returns:
-        exit code 0 if successfully executed.
+        exit code of the command, 0 if successfully executed.
     """
     output_path = str(output_path)
     if output_path.endswith(".nii.gz"):
         output_path = output_path.replace(".nii.gz", '')
 
-    subprocess.run([
+    result = run_cached([
         'bet', f'{input_path}', f'{output_path}', '-f', str(f_value), '-F'
-    ])
-    return 0
+    ], inputs=_image_files(input_path),
+       outputs=_image_files(output_path) + _image_files(f"{output_path}_mask"))
+    return result.returncode
 
 def run_topup(input_path: Union[str, Path],
               acqp_path: Union[str, Path],
@@ -86,26 +118,28 @@ def run_topup(input_path: Union[str, Path],
         output_path: path/to/save/folder/output basename. For example, 
             `output_path=data/corrected/topup_b0`. Then, the output files will 
             `topup_b0_fieldcoef.nii.gz`, `topup_b0_iout.nii.gz`, 
-            `topup_b0_fout.nii.gz`, and `topup_b0_movepar.txt`.
+            `topup_b0_fout.nii.gz`, and `topup_b0_movpar.txt`.
 
     Returns:
-        exit code 0 if completed successfully.
+        exit code of the command, 0 if completed successfully.
     """
 
     iout_output_path = f"{output_path}_iout"
     fout_output_path = f"{output_path}_fout"
 
     with SpinCursor("Running topup...", end=f"Saved at `{output_path}`"):
-        subprocess.run([
+        result = run_cached([
             "topup",
             f"--imain={input_path}",
             f"--datain={acqp_path}",
             f"--out={output_path}",
             f"--iout={iout_output_path}",
             f"--fout={fout_output_path}"
-        ])
+        ], inputs=_image_files(input_path) + [acqp_path],
+           outputs=[f"{output_path}_fieldcoef.nii.gz", f"{output_path}_movpar.txt",
+                    *_image_files(iout_output_path), *_image_files(fout_output_path)])
 
-    return 0
+    return result.returncode
 
 
 def run_eddy(input_path: Union[str, Path],
@@ -145,7 +179,7 @@ def run_eddy(input_path: Union[str, Path],
 
 
     Returns:
-        exit code 0 if completed successfully.
+        exit code of the command, 0 if completed successfully.
     """
 
     with SpinCursor("Running eddy...", end=f"Saved at `{output_path}`"):
@@ -170,8 +204,16 @@ def run_eddy(input_path: Union[str, Path],
             command.append(f"--json={json_path}",)
         if shelled:
             command.append("--data_is_shelled")
-        subprocess.run(command)
-    return 0
+        inputs = [
+            *_image_files(input_path), *_image_files(brain_mask_path),
+            index_path, acqp_path, bvecs_path, bvals_path, json_path or "",
+            f"{topup_path}_fieldcoef.nii.gz", f"{topup_path}_movpar.txt"
+        ]
+        outputs = [*_image_files(output_path)] + [
+            f"{output_path}.eddy_{suffix}" for suffix in EDDY_OUTPUT_SUFFIXES
+        ]
+        result = run_cached(command, inputs=inputs, outputs=outputs)
+    return result.returncode
 
 
 def run_dtifit(input_path: Union[str, Path],
@@ -192,20 +234,22 @@ def run_dtifit(input_path: Union[str, Path],
             as `dti_FA.nii.gz`, `dti_MD.nii.gz`, `dti_V1.nii.gz`, etc.
 
     Returns:
-        exit code 0 if completed successfully.
+        exit code of the command, 0 if completed successfully.
     """
 
     with SpinCursor("Running dtifit...", end=f"Saved at `{output_path}`"):
-        subprocess.run([
+        result = run_cached([
             "dtifit",
             f"--data={input_path}",
             f"--mask={brain_mask_path}",
             f"--bvecs={bvecs_path}",
             f"--bvals={bvals_path}",
             f"--out={output_path}"
-        ])
+        ], inputs=[*_image_files(input_path), *_image_files(brain_mask_path),
+                   bvecs_path, bvals_path],
+           outputs=[f"{output_path}_{name}.nii.gz" for name in DTIFIT_OUTPUT_NAMES])
 
-    return 0
+    return result.returncode
 
 
 def process_one_subject(input_path: Union[str, Path],
@@ -408,7 +452,11 @@ def process_one_subject(input_path: Union[str, Path],
     # If True, Strip skull of eddy corrected 4D DTI data using BET with -F flag
     if strip_skull:
         logger.info(f"Striping skull of DTI eddy corrected data...")
-        dti_skull_strip(eddy_output_path, eddy_output_path)
+        exit_code = dti_skull_strip(eddy_output_path, eddy_output_path)
+        if exit_code != 0:  # Stop here if any error
+            _msg = "Error in `dti_skull_strip` execution :(. Stopped."
+            logger.error(_msg)
+            raise RuntimeError(_msg)
         logger.info("done.")
 
     # * Step 5: DTIFIT - fitting diffusion tensors
@@ -443,10 +491,14 @@ def process_multi_subjects(input_path: Union[str, Path],
                            exclude_list: list = [],
                            strip_skull: bool = True,
                            compression: bool = True,
-                           reorient: bool = True) -> int:
+                           reorient: bool = True,
+                           num_workers: Union[int, None] = NUM_WORKERS,
+                           resume: bool = True) -> int:
     """Process DTI data for multiple subjects.
 
-    The steps involved in this pipeline are mentioned above.
+    The steps involved in this pipeline are mentioned above. The subjects are
+    processed `num_workers` at a time, see `pgimri.parallel`. The status of
+    each subject is saved in `config.MANIFEST_FILENAME` in `output_path`.
 
     Args:
         input_path: path to subjects data where each subject's data can be
@@ -461,6 +513,10 @@ def process_multi_subjects(input_path: Union[str, Path],
             this step with -F flag for 4D data processing[default: True]
         compression: compress .nii to .nii.gz
         reorient: reorient the dicoms according to LAS orientation.
+        num_workers: number of subjects processed at the same time. `None`
+            uses one worker per CPU core. [default: `config.NUM_WORKERS`]
+        resume: skip the subjects completed by a previous run, according to
+            the manifest. [default: True]
 
     Returns:
         exit code 0 upon successful execution.
@@ -482,33 +538,32 @@ def process_multi_subjects(input_path: Union[str, Path],
     input_path, output_path = Path(input_path), Path(output_path)
     output_path.mkdir(parents=True, exist_ok=True)
 
-    subjects_paths, error_list = list(input_path.glob("*")), []
-    total_subjects = len(subjects_paths)
-    for i, subject_path in enumerate(subjects_paths, start=1):
+    manifest_path = output_path/MANIFEST_FILENAME
+    if not resume and manifest_path.exists():
+        manifest_path.unlink()
+    manifest = SubjectManifest(manifest_path)
+
+    subjects_paths, jobs, inputs = list(input_path.glob("*")), {}, {}
+    for subject_path in subjects_paths:
         if (subject_path.stem in exclude_list) and (len(exclude_list) != 0):
             logger.info(f"Subject {subject_path} is in the excluded list. Skipped.")
             continue
-        logger.info(
-            f"{'='*15}[{i}/{total_subjects}] Processing `{subject_path}`{'='*15}")
-        # Run processing steps for each subject
-        try:
-            exit_code = process_one_subject(input_path=subject_path,
-                                            output_path=output_path,
-                                            nifti_method=nifti_method,
-                                            strip_skull=strip_skull,
-                                            compression=compression,
-                                            reorient=reorient)
-            if exit_code == 0:
-                logger.info(f"Proessing completed for `{subject_path}`.")
-            else:
-                _msg = f"Error in processing subject `{subject_path}`"
-                logger.error(_msg)
-                raise RuntimeError(_msg)
-
-        except:
-            _msg = f"Error in processing subject `{subject_path}`"
-            error_list.append(subject_path)
-            logger.error(_msg)
+        jobs[str(subject_path)] = dict(input_path=subject_path,
+                                       output_path=output_path,
+                                       nifti_method=nifti_method,
+                                       strip_skull=strip_skull,
+                                       compression=compression,
+                                       reorient=reorient)
+        # the zip file, or every file of the subject's folder
+        if subject_path.is_dir():
+            inputs[str(subject_path)] = [f"{subject_path}/**/*"]
+        else:
+            inputs[str(subject_path)] = [str(subject_path)]
+
+    # Run processing steps for each subject
+    error_list = run_parallel(process_one_subject, jobs,
+                              num_workers=num_workers, manifest=manifest,
+                              inputs=inputs)
 
     if error_list:
         print("="*10, "Subjects with Errors", "="*10)
@@ -10,6 +10,8 @@ from typing import Union
 from pgimri.config import *
 from pgimri.utils import *
 from pgimri.dtip.convert import fsl_to_dtitk_multi
+from pgimri.parallel import run_parallel, SubjectManifest
+from pgimri.cache import run_cached
 from rich.traceback import install as rich_traceback_install
 
 
@@ -73,7 +75,13 @@ def dtitk_register_pop_multi(input_path: Union[Path, str],
     # create the initial bootstrapped template with the subset data
     logger.debug(f"Creating bootstrap template using {copied_files}")
     template_path = "mean_initial.nii.gz"
-    subprocess.run(['TVMean', '-in', 'subset.txt', '-out', template_path])
+    result = run_cached(['TVMean', '-in', 'subset.txt', '-out', template_path],
+                        inputs=['subset.txt', *copied_files],
+                        outputs=[template_path])
+    if result.returncode != 0:
+        _msg = "`TVMean` failed to create the bootstrap template. Stopped."
+        logger.error(_msg)
+        raise RuntimeError(_msg)
     logger.debug(f"Created bootstrap template @ `{template_path}`.")
     # resample the template into a voxel space with the voxel dimensions
     # being powers of 2
@@ -81,10 +89,14 @@ def dtitk_register_pop_multi(input_path: Union[Path, str],
         "Resampling template into a voxel space with the voxel dimensions being powers of 2")
     W, H, D = [str(v) for v in TEMPLATE_SPATIAL_DIMS]
     X, Y, Z = [str(v) for v in TEMPLATE_VOXEL_SPACE]
-    subprocess.run([
+    result = run_cached([
         'TVResample', '-in', template_path, '-align', 'center', '-size',
         W, H, D, '-vsize', X, Y, Z
-    ])
+    ], inputs=[template_path], outputs=[template_path])
+    if result.returncode != 0:
+        _msg = "`TVResample` failed to resample the bootstrap template. Stopped."
+        logger.error(_msg)
+        raise RuntimeError(_msg)
     logger.info("Done!")
     # remove copied files
     logger.debug("Removing copied files...")
@@ -183,13 +195,26 @@ def dtitk_register_pop_multi(input_path: Union[Path, str],
 def dtitk_register_multi(input_path: Union[Path, str],
                          template_path: Union[Path, str],
                          mean_initial_template_path: Union[Path, str, None],
-                         output_path: Union[Path, str]) -> int:
+                         output_path: Union[Path, str],
+                         num_workers: Union[int, None] = NUM_WORKERS,
+                         resume: bool = True) -> int:
     """DTI existing Template-based Image Registration using Diffusion Tensor Imaging ToolKit (DTI-TK)
 
+    The affine and deformable alignments of the subjects run `num_workers` at
+    a time, see `pgimri.parallel`. Their status is saved in
+    `config.MANIFEST_FILENAME` in `output_path`. An alignment whose command
+    (e.g. template, `NUM_DIFFEO_ITERS`) or input files changed since it was
+    completed is computed again.
+
     Args:
         input_path: folder path containing a subject's data.
         template_path: Path of the template to use for registration.
         output_path: location to save the output files.
+        num_workers: number of subjects registered at the same time. `None`
+            uses one worker per CPU core. [default: `config.NUM_WORKERS`]
+        resume: skip the alignments completed by a previous run with the
+            same command and inputs, according to the manifest.
+            [default: True]
 
     Returns:
         exit code 0 on completion.
@@ -198,6 +223,11 @@ def dtitk_register_multi(input_path: Union[Path, str],
     template_path = Path(template_path)
     output_path.mkdir(parents=True, exist_ok=True)
 
+    manifest_path = output_path/MANIFEST_FILENAME
+    if not resume and manifest_path.exists():
+        manifest_path.unlink()
+    manifest = SubjectManifest(manifest_path)
+
     # * Add dtitk tool to PATH
     dtitk_maindir = f"{Path(__file__).parent.parent.parent}/dtitk"
     os.environ["DTITK_ROOT"] = dtitk_maindir
@@ -206,7 +236,8 @@ def dtitk_register_multi(input_path: Union[Path, str],
     if mean_initial_template_path == None:
         # * Step 1: Convert FSL format to DTI-TK format and move files
         # * to `output_path`.
-        exit_code = fsl_to_dtitk_multi(input_path, output_path)
+        exit_code = fsl_to_dtitk_multi(input_path, output_path,
+                                       num_workers=num_workers)
         if exit_code != 0:  # Stop here if any error
             _msg = "Error in `dtitk_register_multi` execution :(. Stopped."
             logger.error(_msg)
@@ -296,19 +327,24 @@ def dtitk_register_multi(input_path: Union[Path, str],
 
     # * Step 4: Affine alignment with template refinement
     logger.info("Affine alignment with template refinement...")
-    for i, subject_path in enumerate(subs_filepaths, start=1):
-        logger.info(
-            f"[{i}/{len(subs_filepaths)}] Affine alignment of `{subject_path}`...")
-        subprocess.run([
-            'dti_affine_reg', template_path, subject_path,
+    jobs = {}
+    for subject_path in subs_filepaths:
+        subject_basename = subject_path.replace(".nii.gz", "")
+        jobs[f"affine:{subject_path}"] = dict(command=[
+            'dti_affine_reg', str(template_path), subject_path,
             'EDS', '4', '4', '4', '0.001'
-        ])
+        ], inputs=[str(template_path), subject_path],
+           outputs=[f"{subject_basename}.aff", f"{subject_basename}_aff.nii.gz"])
         # logger.info("Adjusting origin to 0, 0, 0.")
         # subprocess.run([
         #     'TVAdjustVoxelspace', '-in', subject_path, '-out', subject_path, '-vsize', str(XV), str(YV), str(ZV), '-origin', '0', '0', '0' 
         # ])
-
-        logger.info("Done!")
+    failed = run_parallel(run_cached, jobs,
+                          num_workers=num_workers, manifest=manifest)
+    if failed:
+        _msg = f"Affine alignment failed for {failed}. Stopped."
+        logger.error(_msg)
+        raise RuntimeError(_msg)
     logger.info("Affine alignment completed!")
 
     # generate the mask image
@@ -325,19 +361,24 @@ def dtitk_register_multi(input_path: Union[Path, str],
 
     # * Step 5: Deformable alignment with template refinement
     # Get subjects' DTI file paths
+    logger.info("Deformable alignment with template refinement...")
+    jobs = {}
     for subject_path in output_path.glob("*"):
         if subject_path.is_dir():
-            logger.info(f"Deformable alignment of subject `{subject_path}`...")
             filename = f"{PROCESSED_DTI_FILENAME}_dtitk_aff.nii.gz"
             filepath = f"{subject_path}/{filename}"
-            # Run alignment
-            logger.info("Deformable alignment with template refinement...")
-            subprocess.run([
+            basename = filepath.replace(".nii.gz", "")
+            jobs[f"diffeo:{filepath}"] = dict(command=[
                 'dti_diffeomorphic_reg',
-                template_path, filepath, 'mask.nii.gz',
+                str(template_path), filepath, 'mask.nii.gz',
                 '1', str(NUM_DIFFEO_ITERS), '0.0002'
-            ])
-            logger.info("Done!")
+            ], inputs=[str(template_path), filepath, 'mask.nii.gz'],
+               outputs=[f"{basename}_diffeo.nii.gz", f"{basename}_diffeo.df.nii.gz"])
+    failed = run_parallel(run_cached, jobs,
+                          num_workers=num_workers, manifest=manifest)
+    if failed:
+        logger.error(f"Deformable alignment failed for {failed}.")
+    logger.info("Done!")
 
     # Move extra generated files to output_path folder
     logger.info(f"Moving all generated files to `{output_path}`")
@@ -0,0 +1,242 @@
+"""This module runs the per-subject work of the pipelines in parallel.
+
+    The subjects are given to a pool of worker processes. Each worker runs
+    one subject at a time and calls the external tools (`dwidenoise`,
+    `topup`, `eddy`, `dtifit`, `fsl_to_dtitk`, DTI-TK commands) through
+    `run_command`, which:
+
+    1. limits the number of concurrent runs of a tool across all workers,
+       as set in `config.STEP_CONCURRENCY` (e.g. one `eddy` at a time).
+    2. gives each worker its share of the CPU cores through
+       `OMP_NUM_THREADS` (and `MRTRIX_NTHREADS` for MRtrix3).
+
+    The status of every subject is kept in a manifest (JSON file) in the
+    output folder, so an interrupted run can be started again and skips the
+    subjects already completed. A subject is only skipped if its arguments
+    (e.g. the command, template and number of iterations) and the content of
+    its input files are the same as when it was completed.
+"""
+
+
+import os
+import glob
+import json
+import hashlib
+import subprocess
+import multiprocessing
+from typing import Callable, Union
+from pathlib import Path
+from datetime import datetime
+from concurrent.futures import ProcessPoolExecutor, as_completed
+from pgimri.utils import get_logger
+from pgimri.config import *
+
+
+__all__ = [
+    "run_command", "run_parallel", "get_num_workers", "SubjectManifest",
+    "job_fingerprint"
+]
+
+logger = get_logger(__name__)
+
+# Concurrency limits of the external tools, set in each worker process
+_STEP_LIMITS = {}
+
+
+def _init_worker(step_limits: dict, num_threads: int):
+    """Set up a worker process of the pool."""
+    global _STEP_LIMITS
+    _STEP_LIMITS = step_limits
+    os.environ["OMP_NUM_THREADS"] = str(num_threads)
+    os.environ["MRTRIX_NTHREADS"] = str(num_threads)
+
+
+def get_num_workers(num_workers: Union[int, None] = NUM_WORKERS) -> int:
+    """Number of workers, one per CPU core if `num_workers` is None."""
+    if num_workers is None:
+        num_workers = os.cpu_count() or 1
+    return max(1, int(num_workers))
+
+
+def get_num_threads(num_workers: int) -> int:
+    """OpenMP threads of each worker so that the workers share the cores."""
+    if OMP_THREADS_PER_WORKER is not None:
+        return OMP_THREADS_PER_WORKER
+    return max(1, (os.cpu_count() or 1) // num_workers)
+
+
+def run_command(command: list, **kwargs) -> subprocess.CompletedProcess:
+    """Run an external tool like `subprocess.run`, waiting for a free slot
+        if the tool has a concurrency limit in `config.STEP_CONCURRENCY`.
+
+    Args:
+        command: the command and its arguments.
+        kwargs: passed to `subprocess.run`.
+
+    Returns:
+        The `subprocess.CompletedProcess` of the command.
+    """
+    tool = Path(str(command[0])).name
+    limit = _STEP_LIMITS.get(tool)
+    if limit is None:
+        return subprocess.run(command, **kwargs)
+    with limit:
+        return subprocess.run(command, **kwargs)
+
+
+class SubjectManifest:
+    """Status of each subject of a run, saved as a JSON file.
+
+        Args:
+            path: path/to/manifest.json. Loaded if it exists.
+
+        Example:
+
+            .. code-block:: python
+
+                manifest = SubjectManifest("processed_data/manifest.json")
+                if not manifest.is_done("subject1"):
+                    ...
+                    manifest.mark("subject1", "done")
+    """
+
+    def __init__(self, path: Union[str, Path]) -> None:
+        self.path = Path(path)
+        self.subjects = {}
+        if self.path.exists():
+            with open(self.path) as mf:
+                self.subjects = json.load(mf)
+
+    def is_done(self, name: str, fingerprint: Union[str, None] = None) -> bool:
+        """Whether the subject was completed, with the same fingerprint
+            (see `job_fingerprint`) if given."""
+        entry = self.subjects.get(name, {})
+        if entry.get("status") != "done":
+            return False
+        return fingerprint is None or entry.get("fingerprint") == fingerprint
+
+    def mark(self, name: str, status: str, **info) -> None:
+        """Set the status of a subject and save the manifest."""
+        entry = {"status": status, "time": datetime.now().isoformat()}
+        entry.update(info)
+        self.subjects[name] = entry
+        self.save()
+
+    def save(self) -> None:
+        """Write the manifest, replacing the old file only once written."""
+        self.path.parent.mkdir(parents=True, exist_ok=True)
+        tmp_path = self.path.with_name(f"{self.path.name}.tmp")
+        with open(tmp_path, "w") as mf:
+            json.dump(self.subjects, mf, indent=4)
+        os.replace(tmp_path, self.path)
+
+
+def job_fingerprint(func: Callable, kwargs: dict,
+                    inputs: Union[list, None] = None) -> str:
+    """SHA-256 of a job: the function, its arguments and the content of its
+        input files.
+
+    Args:
+        func: the function of the job.
+        kwargs: its keyword arguments.
+        inputs: paths or glob patterns (`**` matches any folder depth) of
+            the files read by the job. Defaults to its `inputs` argument, if
+            any (see `pgimri.cache.run_cached`).
+    """
+    from pgimri.cache import hash_file  # pgimri.cache imports this module
+
+    if inputs is None:
+        inputs = kwargs.get("inputs", [])
+    sha = hashlib.sha256()
+    sha.update(func.__name__.encode())
+    sha.update(json.dumps(kwargs, sort_keys=True, default=str).encode())
+    files = set()
+    for pattern in inputs:
+        files.update(p for p in glob.glob(str(pattern), recursive=True)
+                     if os.path.isfile(p))
+    for path in sorted(files):
+        sha.update(f"{path}:{hash_file(path)}".encode())
+    return sha.hexdigest()
+
+
+def _run_job(func: Callable, kwargs: dict):
+    """Run one job, failing on a non-zero exit code."""
+    result = func(**kwargs)
+    if isinstance(result, subprocess.CompletedProcess):
+        result.check_returncode()
+    elif result not in (0, None):
+        raise RuntimeError(f"`{func.__name__}` returned exit code {result}.")
+    return result
+
+
+def run_parallel(func: Callable,
+                 jobs: dict,
+                 num_workers: Union[int, None] = NUM_WORKERS,
+                 manifest: Union[SubjectManifest, None] = None,
+                 inputs: Union[dict, None] = None) -> list:
+    """Run `func` for every job, `num_workers` at a time.
+
+    Args:
+        func: a module level function (it is sent to the worker processes),
+            e.g. `process_one_subject` or `run_command`.
+        jobs: job name (e.g. subject name) -> keyword arguments of `func`.
+        num_workers: number of worker processes. With 1, the jobs run one
+            after the other in this process.
+        manifest: if given, the jobs already done with the same arguments
+            and inputs are skipped and the status of every job is recorded.
+        inputs: job name -> paths or glob patterns of the files it reads,
+            for the jobs whose function has no `inputs` argument (e.g.
+            `process_one_subject`). See `job_fingerprint`.
+
+    Returns:
+        list of the names of the failed jobs.
+    """
+    num_workers = get_num_workers(num_workers)
+    fingerprints = {}
+    if manifest is not None:
+        inputs = inputs or {}
+        fingerprints = {name: job_fingerprint(func, kwargs, inputs.get(name))
+                        for name, kwargs in jobs.items()}
+        skipped = [name for name in jobs
+                   if manifest.is_done(name, fingerprints[name])]
+        for name in skipped:
+            logger.info(f"`{name}` already completed. Skipped.")
+        jobs = {n: kw for n, kw in jobs.items() if n not in skipped}
+
+    failed = []
+
+    def _finished(name: str, error: Union[Exception, None]):
+        if error is None:
+            logger.info(f"Completed `{name}`.")
+            if manifest is not None:
+                manifest.mark(name, "done", fingerprint=fingerprints[name])
+        else:
+            logger.error(f"Error in `{name}`: {error}")
+            failed.append(name)
+            if manifest is not None:
+                manifest.mark(name, "failed", error=str(error))
+
+    if num_workers == 1:
+        for i, (name, kwargs) in enumerate(jobs.items(), start=1):
+            logger.info(f"[{i}/{len(jobs)}] Running `{name}`...")
+            try:
+                _run_job(func, kwargs)
+                _finished(name, None)
+            except Exception as e:
+                _finished(name, e)
+        return failed
+
+    num_threads = get_num_threads(num_workers)
+    logger.info(
+        f"Running {len(jobs)} jobs on {num_workers} workers with {num_threads} threads each.")
+    context = multiprocessing.get_context()
+    step_limits = {tool: context.BoundedSemaphore(n)
+                   for tool, n in STEP_CONCURRENCY.items() if n}
+    with ProcessPoolExecutor(max_workers=num_workers, mp_context=context,
+                             initializer=_init_worker,
+                             initargs=(step_limits, num_threads)) as executor:
+        futures = {executor.submit(_run_job, func, kwargs): name
+                   for name, kwargs in jobs.items()}
+        for future in as_completed(futures):
+            _finished(futures[future], future.exception())
+    return failed
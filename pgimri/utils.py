@@ -2,6 +2,7 @@ import logging
 import logging.config
 import click_logging
 import time
+import multiprocessing
 from typing import Callable, Any
 from itertools import cycle
 from shutil import get_terminal_size
@@ -126,8 +127,13 @@ class SpinCursor:
         self.done = False
 
     def start(self):
-        """Start the animation. See example above."""
-        self._thread.start()
+        """Start the animation. See example above.
+
+            The animation is not shown in the worker processes of
+            `pgimri.parallel`, where the cursors would overwrite each other.
+        """
+        if multiprocessing.parent_process() is None:
+            self._thread.start()
         return self
 
     def _animate(self):